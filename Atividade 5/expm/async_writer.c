@@ -0,0 +1,143 @@
+#include "async_writer.h"
+
+static void *writerLoop(void *arg)
+{
+    AsyncWriter *w = (AsyncWriter *)arg;
+    WriteJob *job;
+    int res;
+
+    while (1)
+    {
+        pthread_mutex_lock(&w->lock);
+
+        while (w->count == 0 && !w->closing)
+        {
+            pthread_cond_wait(&w->notEmpty, &w->lock);
+        }
+
+        if (w->count == 0)
+        {
+            // Closing and nothing left to write
+            pthread_mutex_unlock(&w->lock);
+            return NULL;
+        }
+
+        job = w->queue[w->head];
+        w->head = (w->head + 1) % ASYNC_QUEUE_SIZE;
+        w->count--;
+
+        pthread_cond_signal(&w->notFull);
+        pthread_mutex_unlock(&w->lock);
+
+        if (job->full)
+        {
+            res = printFullMatrixToFile(job->filename, job->name, job->snapshot, job->format, job->append);
+        }
+        else
+        {
+            res = printMatrixToFile(job->filename, job->name, job->snapshot, job->format, job->append);
+        }
+
+        if (res != OK)
+        {
+            pthread_mutex_lock(&w->lock);
+            w->res = NOK;
+            pthread_mutex_unlock(&w->lock);
+        }
+
+        destroyMatrix(job->snapshot);
+        free(job->filename);
+        free(job->name);
+        free(job);
+    }
+}
+
+AsyncWriter *createAsyncWriter(void)
+{
+    AsyncWriter *w = (AsyncWriter *)malloc(sizeof(AsyncWriter));
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->notEmpty, NULL);
+    pthread_cond_init(&w->notFull, NULL);
+
+    w->head = 0;
+    w->count = 0;
+    w->closing = 0;
+    w->res = OK;
+
+    pthread_create(&w->thread, NULL, writerLoop, w);
+
+    return w;
+}
+
+int asyncWriteMatrix(AsyncWriter *w,
+                     const char *filename,
+                     const char *name,
+                     const Matrix *m,
+                     int format,
+                     int append,
+                     int full)
+{
+    WriteJob *job = (WriteJob *)malloc(sizeof(WriteJob));
+
+    job->filename = strdup(filename);
+    job->name = name != NULL ? strdup(name) : NULL;
+    job->format = format;
+    job->append = append;
+    job->full = full;
+
+    if (full)
+    {
+        job->snapshot = duplicateMatrix(m);
+    }
+    else
+    {
+        // One extra row and column keeps the " ..." markers
+        long nRows = m->nRows > MAX_ROWS_TO_OUTPUT ? MAX_ROWS_TO_OUTPUT + 1 : m->nRows;
+        long nColumns = m->nColumns > MAX_COLUMNS_TO_OUTPUT ? MAX_COLUMNS_TO_OUTPUT + 1 : m->nColumns;
+
+        job->snapshot = createMatrix(nRows, nColumns);
+        copySubMatrix(job->snapshot, m, 0, 0, 0, 0, nRows, nColumns);
+    }
+
+    pthread_mutex_lock(&w->lock);
+
+    while (w->count == ASYNC_QUEUE_SIZE)
+    {
+        pthread_cond_wait(&w->notFull, &w->lock);
+    }
+
+    w->queue[(w->head + w->count) % ASYNC_QUEUE_SIZE] = job;
+    w->count++;
+
+    pthread_cond_signal(&w->notEmpty);
+    pthread_mutex_unlock(&w->lock);
+
+    return OK;
+}
+
+int destroyAsyncWriter(AsyncWriter *w)
+{
+    int res;
+
+    if (w == NULL)
+    {
+        return OK;
+    }
+
+    pthread_mutex_lock(&w->lock);
+    w->closing = 1;
+    pthread_cond_signal(&w->notEmpty);
+    pthread_mutex_unlock(&w->lock);
+
+    pthread_join(w->thread, NULL);
+
+    res = w->res;
+
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->notEmpty);
+    pthread_cond_destroy(&w->notFull);
+    free(w);
+
+    return res;
+}
@@ -0,0 +1,70 @@
+#ifndef __ASYNC_WRITER_H__
+#define __ASYNC_WRITER_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "matrix.h"
+#include "fast_output.h"
+
+/**
+ * A matrix waiting to be written
+ */
+typedef struct write_job
+{
+    char *filename;
+    char *name;
+    Matrix *snapshot;
+    int format;
+    int append;
+    int full;
+} WriteJob;
+
+/**
+ * Background thread that writes matrices to disk while the solver
+ * continues. The queue is bounded: asyncWriteMatrix blocks while it
+ * is full.
+ */
+typedef struct async_writer
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+
+    WriteJob *queue[ASYNC_QUEUE_SIZE];
+    int head;
+    int count;
+
+    // Set when no more jobs will be added
+    int closing;
+
+    // NOK if any write failed
+    int res;
+} AsyncWriter;
+
+AsyncWriter *createAsyncWriter(void);
+
+/**
+ * Queues a snapshot of m to be written like printMatrixToFile
+ * (or printFullMatrixToFile if full is set).
+ * Only the part of m that will be written is copied, so m can be
+ * changed as soon as this returns.
+ */
+int asyncWriteMatrix(AsyncWriter *w,
+                     const char *filename,
+                     const char *name,
+                     const Matrix *m,
+                     int format,
+                     int append,
+                     int full);
+
+/**
+ * Waits for every queued matrix to be written and stops the thread.
+ * Returns NOK if any write failed.
+ */
+int destroyAsyncWriter(AsyncWriter *w);
+
+#endif
@@ -0,0 +1,476 @@
+#include "block_triangular.h"
+
+/**
+ * Block column and the flops of one of its terms, for the distribution
+ */
+typedef struct block_column
+{
+    double cost;
+    long column;
+} BlockColumn;
+
+/**
+ * Tarjan's algorithm, without recursion: call[] holds the vertices being
+ * visited and next[] the column where their edge scan stopped.
+ * The components come out sinks first, so they are placed from the end:
+ * an edge can only go to the same component or to one further down.
+ */
+long findComponents(const Matrix *a, long *order, long *starts)
+{
+    long n = a->nRows;
+    long *index = (long *)malloc(sizeof(long) * n);
+    long *low = (long *)malloc(sizeof(long) * n);
+    char *onStack = (char *)malloc(sizeof(char) * n);
+    long *stack = (long *)malloc(sizeof(long) * n);
+    long *call = (long *)malloc(sizeof(long) * n);
+    long *next = (long *)malloc(sizeof(long) * n);
+
+    long counter = 0, sp = 0, cp = 0;
+    long position = n, nComponents = 0;
+
+    for (long i = 0; i < n; i++)
+    {
+        index[i] = -1;
+        onStack[i] = 0;
+    }
+
+    for (long root = 0; root < n; root++)
+    {
+        if (index[root] != -1)
+        {
+            continue;
+        }
+
+        index[root] = low[root] = counter++;
+        stack[sp++] = root;
+        onStack[root] = 1;
+        call[cp] = root;
+        next[cp++] = 0;
+
+        while (cp > 0)
+        {
+            long v = call[cp - 1];
+            long j = next[cp - 1];
+
+            if (j < n)
+            {
+                next[cp - 1]++;
+
+                if (a->data[v * n + j] == 0.0)
+                {
+                    continue;
+                }
+
+                if (index[j] == -1)
+                {
+                    index[j] = low[j] = counter++;
+                    stack[sp++] = j;
+                    onStack[j] = 1;
+                    call[cp] = j;
+                    next[cp++] = 0;
+                }
+                else if (onStack[j] && index[j] < low[v])
+                {
+                    low[v] = index[j];
+                }
+
+                continue;
+            }
+
+            // All the edges of v were visited
+            if (low[v] == index[v])
+            {
+                long w;
+                do
+                {
+                    w = stack[--sp];
+                    onStack[w] = 0;
+                    order[--position] = w;
+                } while (w != v);
+
+                // Start of the component, reversed below
+                starts[nComponents++] = position;
+            }
+
+            cp--;
+            if (cp > 0 && low[v] < low[call[cp - 1]])
+            {
+                low[call[cp - 1]] = low[v];
+            }
+        }
+    }
+
+    for (long c = 0; c < nComponents / 2; c++)
+    {
+        long tmp = starts[c];
+        starts[c] = starts[nComponents - 1 - c];
+        starts[nComponents - 1 - c] = tmp;
+    }
+    starts[nComponents] = n;
+
+    free(index);
+    free(low);
+    free(onStack);
+    free(stack);
+    free(call);
+    free(next);
+
+    return nComponents;
+}
+
+static int compareBlockColumns(const void *a, const void *b)
+{
+    double ca = ((const BlockColumn *)a)->cost;
+    double cb = ((const BlockColumn *)b)->cost;
+
+    return (ca < cb) - (ca > cb);
+}
+
+/**
+ * Gives the most expensive block columns first to the least loaded
+ * process
+ */
+static void assignColumns(long nComponents, const long *starts, int npes, int *owner)
+{
+    BlockColumn *columns = (BlockColumn *)malloc(sizeof(BlockColumn) * nComponents);
+    double *load = (double *)malloc(sizeof(double) * npes);
+
+    for (long j = 0; j < nComponents; j++)
+    {
+        double width = starts[j + 1] - starts[j];
+
+        columns[j].column = j;
+        columns[j].cost = 0.0;
+
+        for (long c = 0; c <= j; c++)
+        {
+            columns[j].cost += (double)(starts[c + 1] - starts[c]) * (starts[j + 1] - starts[c]) * width;
+        }
+    }
+
+    qsort(columns, nComponents, sizeof(BlockColumn), compareBlockColumns);
+
+    for (int p = 0; p < npes; p++)
+    {
+        load[p] = 0.0;
+    }
+
+    for (long i = 0; i < nComponents; i++)
+    {
+        int best = 0;
+        for (int p = 1; p < npes; p++)
+        {
+            if (load[p] < load[best])
+            {
+                best = p;
+            }
+        }
+
+        owner[columns[i].column] = best;
+        load[best] += columns[i].cost;
+    }
+
+    free(columns);
+    free(load);
+}
+
+/**
+ * exp(t T) restricted to block column j: rows 0 to starts[j+1]-1 (the
+ * rows below are zero) and the columns of block j.
+ * Returns one matrix per t.
+ */
+static Matrix **blockColumnTaylor(const ParsedParams *params,
+                                  const Matrix *t,
+                                  const long *starts,
+                                  long j,
+                                  long strassenCutoff,
+                                  long nTerms)
+{
+    long first = starts[j];
+    long nRows = starts[j + 1];
+    long width = nRows - first;
+
+    Matrix *m = createMatrix(nRows, width);
+    Matrix *multiplied = createMatrix(nRows, width);
+    Matrix **s = (Matrix **)malloc(sizeof(Matrix *) * params->nTimes);
+    double *powers = (double *)malloc(sizeof(double) * params->nTimes);
+    double *tmp;
+    double scale;
+
+    // M1 = T(:, j)
+    copySubMatrix(m, t, 0, 0, 0, first, nRows, width);
+
+    // S1 = I(:, j) + t M1
+    for (int i = 0; i < params->nTimes; i++)
+    {
+        s[i] = createMatrix(nRows, width);
+        setIdentitySubMatrix(s[i], 0, first);
+        powers[i] = 1.0;
+    }
+    scale = sumTaylorTerm(m, s, params->times, powers, params->nTimes);
+
+    long k = 2;
+
+    do
+    {
+        fillMatrixWithZeros(multiplied);
+
+        // M_k = T * M_k-1 / k, row block c only meets blocks c..j
+        for (long c = 0; starts[c] < nRows; c++)
+        {
+            multiplyMatrixAndSumStrassen(t,
+                                         m,
+                                         multiplied,
+                                         starts[c],
+                                         starts[c],
+                                         starts[c],
+                                         0,
+                                         starts[c],
+                                         0,
+                                         starts[c + 1] - starts[c],
+                                         nRows - starts[c],
+                                         width,
+                                         strassenCutoff);
+        }
+
+        tmp = multiplied->data;
+        multiplied->data = m->data;
+        m->data = tmp;
+
+        divideMatrixByLong(m, k);
+
+        // S_k = S_k-1 + t^k M_k
+        scale = sumTaylorTerm(m, s, params->times, powers, params->nTimes);
+
+        k++;
+    } while ((params->aPriori && k <= nTerms) ||
+             ((!params->aPriori || params->finalCheck) && maxMij(m) * scale > params->tolerance));
+
+    destroyMatrix(m);
+    destroyMatrix(multiplied);
+    free(powers);
+
+    return s;
+}
+
+/**
+ * Adds block column j of exp(t_i T) to globalS[i] = exp(t_i A)
+ */
+static void scatterBlockColumn(Matrix **globalS, Matrix **column, int nTimes, const long *order, long first)
+{
+    long n = globalS[0]->nColumns;
+
+    for (int i = 0; i < nTimes; i++)
+    {
+        for (long r = 0; r < column[i]->nRows; r++)
+        {
+            for (long c = 0; c < column[i]->nColumns; c++)
+            {
+                globalS[i]->data[order[r] * n + order[first + c]] = column[i]->data[r * column[i]->nColumns + c];
+            }
+        }
+    }
+}
+
+int blockTriangularProcess(ParsedParams *params,
+                           const Matrix *globalA,
+                           Matrix **globalS,
+                           int myrank,
+                           int npes,
+                           MPI_Comm comm)
+{
+    long n = params->n;
+    long *order = (long *)malloc(sizeof(long) * n);
+    long *starts = (long *)malloc(sizeof(long) * (n + 1));
+    long nComponents = 0;
+
+    if (myrank == 0)
+    {
+        nComponents = findComponents(globalA, order, starts);
+    }
+
+    MPI_Bcast(&nComponents, 1, MPI_LONG, 0, comm);
+
+    if (nComponents == 1)
+    {
+        free(order);
+        free(starts);
+
+        if (myrank == 0)
+        {
+            printf("A is irreducible: no block triangular form\n");
+        }
+
+        if (npes == 1)
+        {
+            return singleProcess(params, globalA, globalS);
+        }
+
+        return multiProcess(params, globalA, globalS, myrank, npes, comm);
+    }
+
+    MPI_Bcast(order, n, MPI_LONG, 0, comm);
+    MPI_Bcast(starts, nComponents + 1, MPI_LONG, 0, comm);
+
+    if (myrank == 0)
+    {
+        long largest = 0;
+        for (long c = 0; c < nComponents; c++)
+        {
+            if (starts[c + 1] - starts[c] > largest)
+            {
+                largest = starts[c + 1] - starts[c];
+            }
+        }
+
+        printf("Block triangular form: %ld diagonal blocks, largest %ld\n", nComponents, largest);
+    }
+
+    // T = P A P^T, on every process
+    Matrix *t = createMatrix(n, n);
+    MPI_Datatype rowType = createRowType(n);
+
+    if (myrank == 0)
+    {
+        for (long i = 0; i < n; i++)
+        {
+            for (long j = 0; j < n; j++)
+            {
+                t->data[i * n + j] = globalA->data[order[i] * n + order[j]];
+            }
+        }
+    }
+
+    MPI_Bcast(t->data, (int)n, rowType, 0, comm);
+    MPI_Type_free(&rowType);
+
+    /**
+     * Strassen-Winograd is less accurate than the classic multiplication:
+     * only use it if the error on T * T is within the tolerance
+     */
+    long strassenCutoff = params->strassenCutoff;
+
+    if (strassenCutoff > 0)
+    {
+        double error = 0.0;
+        if (myrank == 0)
+        {
+            error = strassenError(t, strassenCutoff);
+        }
+
+        MPI_Bcast(&error, 1, MPI_DOUBLE, 0, comm);
+        if (error > params->tolerance)
+        {
+            if (myrank == 0)
+            {
+                printf("[WARNING] Strassen error %e is above the tolerance. Disabled.\n", error);
+            }
+            strassenCutoff = 0;
+        }
+    }
+
+    /**
+     * Number of terms from the a-priori bound. The norms of T bound the
+     * norms of its leading blocks.
+     */
+    long nTerms = 0;
+
+    if (params->aPriori)
+    {
+        double norm = fmin(maxRowSum(t), maxColumnSum(t)) * maxAbsTime(params);
+
+        nTerms = termsForTolerance(norm, params->tolerance);
+        if (myrank == 0)
+        {
+            printf("A-priori bound: %ld terms\n", nTerms);
+        }
+    }
+
+    int *owner = (int *)malloc(sizeof(int) * nComponents);
+    assignColumns(nComponents, starts, npes, owner);
+
+    // Our block columns
+    Matrix ***columns = (Matrix ***)calloc(nComponents, sizeof(Matrix **));
+
+    for (long j = 0; j < nComponents; j++)
+    {
+        if (owner[j] == myrank)
+        {
+            columns[j] = blockColumnTaylor(params, t, starts, j, strassenCutoff, nTerms);
+        }
+    }
+
+    // Everything below the diagonal blocks is zero
+    if (myrank == 0)
+    {
+        for (int i = 0; i < params->nTimes; i++)
+        {
+            fillMatrixWithZeros(globalS[i]);
+        }
+    }
+
+    // Collect the block columns in order, so the sends can't deadlock
+    for (long j = 0; j < nComponents; j++)
+    {
+        long first = starts[j];
+        long nRows = starts[j + 1];
+        long width = nRows - first;
+
+        if (owner[j] == myrank && myrank == 0)
+        {
+            scatterBlockColumn(globalS, columns[j], params->nTimes, order, first);
+        }
+        else if (owner[j] == myrank || myrank == 0)
+        {
+            MPI_Datatype columnRowType = createRowType(width);
+
+            if (myrank == 0)
+            {
+                columns[j] = (Matrix **)malloc(sizeof(Matrix *) * params->nTimes);
+            }
+
+            for (int i = 0; i < params->nTimes; i++)
+            {
+                if (myrank == 0)
+                {
+                    columns[j][i] = createMatrix(nRows, width);
+                    MPI_Recv(columns[j][i]->data,
+                             (int)nRows,
+                             columnRowType,
+                             owner[j],
+                             MESSAGE_TAG_BLOCK_COLUMN,
+                             comm,
+                             MPI_STATUS_IGNORE);
+                }
+                else
+                {
+                    MPI_Send(columns[j][i]->data, (int)nRows, columnRowType, 0, MESSAGE_TAG_BLOCK_COLUMN, comm);
+                }
+            }
+
+            if (myrank == 0)
+            {
+                scatterBlockColumn(globalS, columns[j], params->nTimes, order, first);
+            }
+
+            MPI_Type_free(&columnRowType);
+        }
+
+        if (columns[j] != NULL)
+        {
+            for (int i = 0; i < params->nTimes; i++)
+            {
+                destroyMatrix(columns[j][i]);
+            }
+            free(columns[j]);
+        }
+    }
+
+    destroyMatrix(t);
+    free(columns);
+    free(owner);
+    free(order);
+    free(starts);
+
+    return OK;
+}
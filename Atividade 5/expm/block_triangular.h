@@ -0,0 +1,49 @@
+#ifndef __BLOCK_TRIANGULAR_H__
+#define __BLOCK_TRIANGULAR_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "matrix.h"
+#include "parse_param.h"
+#include "transport.h"
+#include "single_process.h"
+#include "multi_process.h"
+
+/**
+ * Reducible A (-B): the strongly connected components of the graph with
+ * an edge i -> j for each a(i,j) != 0 give a permutation P such that
+ * T = P A P^T is block upper triangular, and exp(A) = P^T exp(T) P.
+ *
+ * Each block column j of exp(T) only depends on the leading rows and
+ * columns of T up to the end of block j:
+ *   M_k(:, j) = T M_k-1(:, j) / k, M_0(:, j) = I(:, j)
+ * so every block column, with its diagonal block exp(T_jj) and the
+ * coupling blocks above it, is an independent Taylor series with its
+ * own convergence check. The block columns are spread over the
+ * processes and the products skip the zero blocks below the diagonal.
+ */
+
+/**
+ * Finds the strongly connected components of the sparsity graph of a.
+ * order[p] is the row of A at position p of T, and component c takes
+ * the positions starts[c] to starts[c+1]-1 (starts has n+1 items).
+ * Returns the number of components.
+ */
+long findComponents(const Matrix *a, long *order, long *starts);
+
+/**
+ * Calculates globalS[i] = exp(t_i globalA) using the block triangular
+ * form of globalA on the npes processes of comm. Falls back to
+ * singleProcess / multiProcess if A is irreducible.
+ * globalA and globalS are only used on the process with rank 0.
+ */
+int blockTriangularProcess(ParsedParams *params,
+                           const Matrix *globalA,
+                           Matrix **globalS,
+                           int myrank,
+                           int npes,
+                           MPI_Comm comm);
+
+#endif
@@ -0,0 +1,283 @@
+#include "cache.h"
+
+#define CACHE_MAGIC 0x4d50584543414348UL
+
+/**
+ * Parameters stored at the start of each entry, before the t values
+ * and the S
+ */
+typedef struct cache_header
+{
+    uint64_t magic;
+    int64_t n;
+    int64_t nTimes;
+    double tolerance;
+    int64_t aPriori;
+    int64_t strassenCutoff;
+    int64_t compression;
+    int64_t backend;
+} CacheHeader;
+
+static void fillHeader(const ParsedParams *params, CacheHeader *header)
+{
+    memset(header, 0, sizeof(CacheHeader));
+
+    header->magic = CACHE_MAGIC;
+    header->n = params->n;
+    header->nTimes = params->nTimes;
+    header->tolerance = params->tolerance;
+    header->aPriori = params->aPriori + 2 * params->finalCheck;
+    header->strassenCutoff = params->strassenCutoff;
+    header->compression = params->compression;
+
+    // The backends don't round the same way
+    header->backend = params->backend;
+}
+
+/**
+ * 64 bit hash of length bytes (FNV-1a with a final mix)
+ */
+static uint64_t hashBytes(const void *data, size_t length, uint64_t h)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        h = (h ^ bytes[i]) * 0x100000001b3UL;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdUL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+static void entryPath(const ParsedParams *params, const char *key, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%s.expm", params->cacheDir, key);
+}
+
+int cacheKey(const ParsedParams *params, const Matrix *a, char *key)
+{
+    CacheHeader header;
+    uint64_t h[2] = {0, 0};
+    uint64_t seeds[2] = {0xcbf29ce484222325UL, 0x84222325cbf29ce4UL};
+
+    fillHeader(params, &header);
+
+    for (int k = 0; k < 2; k++)
+    {
+        uint64_t sum = 0;
+
+        // Row hashes, mixed with the row number so that swapped rows
+        // give another key
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+ : sum)
+#endif
+        for (long i = 0; i < a->nRows; i++)
+        {
+            sum += hashBytes(&a->data[i * a->nColumns], sizeof(double) * a->nColumns, seeds[k] ^ (uint64_t)i);
+        }
+
+        h[k] = hashBytes(&header, sizeof(CacheHeader), sum);
+        h[k] = hashBytes(params->times, sizeof(double) * params->nTimes, h[k]);
+    }
+
+    snprintf(key, CACHE_KEY_LENGTH + 1, "%016llx%016llx", (unsigned long long)h[0], (unsigned long long)h[1]);
+
+    return OK;
+}
+
+int cacheLoad(const ParsedParams *params, const char *key, Matrix **s)
+{
+    char path[4096];
+    CacheHeader header, expected;
+    int res = OK;
+
+    entryPath(params, key, path, sizeof(path));
+    fillHeader(params, &expected);
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        return NOK;
+    }
+
+    double *times = (double *)malloc(sizeof(double) * params->nTimes);
+
+    if (fread(&header, sizeof(CacheHeader), 1, fp) != 1 ||
+        memcmp(&header, &expected, sizeof(CacheHeader)) != 0 ||
+        fread(times, sizeof(double), params->nTimes, fp) != (size_t)params->nTimes ||
+        memcmp(times, params->times, sizeof(double) * params->nTimes) != 0)
+    {
+        res = NOK;
+    }
+
+    for (int i = 0; i < params->nTimes && res == OK; i++)
+    {
+        size_t length = s[i]->nRows * s[i]->nColumns;
+
+        if (fread(s[i]->data, sizeof(double), length, fp) != length)
+        {
+            res = NOK;
+        }
+    }
+
+    fclose(fp);
+    free(times);
+
+    if (res == OK)
+    {
+        // Most recently used
+        utime(path, NULL);
+    }
+
+    return res;
+}
+
+/**
+ * Entry of the directory listing used for the eviction
+ */
+typedef struct cache_entry
+{
+    char name[256];
+    double used;
+    off_t size;
+} CacheEntry;
+
+static int compareEntries(const void *a, const void *b)
+{
+    const CacheEntry *x = (const CacheEntry *)a;
+    const CacheEntry *y = (const CacheEntry *)b;
+
+    return (x->used > y->used) - (x->used < y->used);
+}
+
+/**
+ * Removes the least recently used entries until the directory holds at
+ * most limit bytes of entries
+ */
+static int evictEntries(const ParsedParams *params, long limit)
+{
+    char path[4096];
+    struct dirent *de;
+    struct stat st;
+    long total = 0;
+    int nEntries = 0, capacity = 64;
+
+    DIR *dir = opendir(params->cacheDir);
+    if (dir == NULL)
+    {
+        return NOK;
+    }
+
+    CacheEntry *entries = (CacheEntry *)malloc(sizeof(CacheEntry) * capacity);
+
+    while ((de = readdir(dir)) != NULL)
+    {
+        size_t length = strlen(de->d_name);
+
+        if (length < 5 || length >= sizeof(entries->name) || strcmp(de->d_name + length - 5, ".expm") != 0)
+        {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", params->cacheDir, de->d_name);
+        if (stat(path, &st) != 0)
+        {
+            continue;
+        }
+
+        if (nEntries == capacity)
+        {
+            capacity *= 2;
+            entries = (CacheEntry *)realloc(entries, sizeof(CacheEntry) * capacity);
+        }
+
+        strcpy(entries[nEntries].name, de->d_name);
+        entries[nEntries].used = st.st_mtim.tv_sec + st.st_mtim.tv_nsec * 1e-9;
+        entries[nEntries].size = st.st_size;
+        total += st.st_size;
+        nEntries++;
+    }
+
+    closedir(dir);
+
+    qsort(entries, nEntries, sizeof(CacheEntry), compareEntries);
+
+    for (int i = 0; i < nEntries && total > limit; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", params->cacheDir, entries[i].name);
+
+        // Another run may have removed it already
+        if (unlink(path) == 0)
+        {
+            printf("Cache: evicted %s\n", entries[i].name);
+        }
+        total -= entries[i].size;
+    }
+
+    free(entries);
+
+    return OK;
+}
+
+int cacheStore(const ParsedParams *params, const char *key, Matrix **s)
+{
+    char path[4096], tmpPath[4096];
+    CacheHeader header;
+    int res = OK;
+    long size = sizeof(CacheHeader) + sizeof(double) * params->nTimes;
+
+    for (int i = 0; i < params->nTimes; i++)
+    {
+        size += sizeof(double) * s[i]->nRows * s[i]->nColumns;
+    }
+
+    if (size > params->cacheLimit)
+    {
+        // It would evict everything and itself
+        return NOK;
+    }
+
+    fillHeader(params, &header);
+    entryPath(params, key, path, sizeof(path));
+    snprintf(tmpPath, sizeof(tmpPath), "%s/.%s-XXXXXX", params->cacheDir, key);
+
+    int fd = mkstemp(tmpPath);
+    if (fd == -1)
+    {
+        return NOK;
+    }
+
+    // Other users of the directory read it too
+    fchmod(fd, 0644);
+
+    FILE *fp = fdopen(fd, "wb");
+
+    if (fwrite(&header, sizeof(CacheHeader), 1, fp) != 1 ||
+        fwrite(params->times, sizeof(double), params->nTimes, fp) != (size_t)params->nTimes)
+    {
+        res = NOK;
+    }
+
+    for (int i = 0; i < params->nTimes && res == OK; i++)
+    {
+        size_t length = s[i]->nRows * s[i]->nColumns;
+
+        if (fwrite(s[i]->data, sizeof(double), length, fp) != length)
+        {
+            res = NOK;
+        }
+    }
+
+    if (fclose(fp) != 0 || res != OK || rename(tmpPath, path) != 0)
+    {
+        unlink(tmpPath);
+        return NOK;
+    }
+
+    // Make room for the new entry
+    return evictEntries(params, params->cacheLimit);
+}
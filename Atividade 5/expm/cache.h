@@ -0,0 +1,52 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "matrix.h"
+#include "parse_param.h"
+
+/**
+ * On-disk cache of the results (-C), shared by every run that uses the
+ * same directory.
+ *
+ * The key is a 128 bit hash of A and of the parameters that change S:
+ * n, tolerance, t values, a-priori bound, Strassen cutoff and
+ * compression. Each row of A is hashed on its own and the row hashes
+ * are combined with a sum, so they are computed in parallel (threads,
+ * see -j) and the key doesn't depend on the number of processes.
+ *
+ * Each entry is one file, named after its key, with the parameters
+ * (checked on load) and every S. Entries are written to a temporary
+ * file and renamed, so concurrent runs never see half an entry. A hit
+ * updates the modification time of the entry: when the directory goes
+ * over its size limit the entries with the oldest times (least
+ * recently used) are removed.
+ */
+
+/**
+ * Hex key (CACHE_KEY_LENGTH characters and the terminator) of A and
+ * the parameters
+ */
+int cacheKey(const ParsedParams *params, const Matrix *a, char *key);
+
+/**
+ * Reads the S of key into s. Returns NOK if there is no such entry.
+ */
+int cacheLoad(const ParsedParams *params, const char *key, Matrix **s);
+
+/**
+ * Adds the entry for key and evicts the least recently used ones over
+ * params->cacheLimit bytes
+ */
+int cacheStore(const ParsedParams *params, const char *key, Matrix **s);
+
+#endif
@@ -0,0 +1,163 @@
+#include "compression.h"
+
+/**
+ * Formats of the packed values
+ */
+#define COMPRESSED_FLOAT 0
+#define COMPRESSED_INT8 1
+#define COMPRESSED_INT16 2
+#define COMPRESSED_INT32 3
+#define COMPRESSED_DOUBLE 4
+
+typedef struct compressed_header
+{
+    int format;
+    double step;
+} CompressedHeader;
+
+/**
+ * Bytes of each packed value of a format
+ */
+static long bytesPerValue(int format)
+{
+    switch (format)
+    {
+    case COMPRESSED_FLOAT:
+        return sizeof(float);
+    case COMPRESSED_INT8:
+        return sizeof(int8_t);
+    case COMPRESSED_INT16:
+        return sizeof(int16_t);
+    case COMPRESSED_INT32:
+        return sizeof(int32_t);
+    default:
+        return sizeof(double);
+    }
+}
+
+long maxCompressedSize(long n)
+{
+    return sizeof(CompressedHeader) + sizeof(double) * n;
+}
+
+long compressBlock(const double *data, long n, int mode, double maxError, char *packed)
+{
+    CompressedHeader header;
+    char *values = packed + sizeof(CompressedHeader);
+
+    header.step = 2.0 * maxError;
+
+    double max = 0.0;
+    for (long i = 0; i < n; i++)
+    {
+        if (fabs(data[i]) > max)
+        {
+            max = fabs(data[i]);
+        }
+    }
+
+    if (mode == COMPRESSION_FLOAT && max * FLT_EPSILON > maxError)
+    {
+        // Rounding to float would be above the error bound
+        header.format = COMPRESSED_DOUBLE;
+        memcpy(values, data, sizeof(double) * n);
+    }
+    else if (mode == COMPRESSION_FLOAT)
+    {
+        header.format = COMPRESSED_FLOAT;
+
+        float *f = (float *)values;
+        for (long i = 0; i < n; i++)
+        {
+            f[i] = (float)data[i];
+        }
+    }
+    else
+    {
+        // Largest multiple of the step
+        double multiples = header.step > 0.0 ? nearbyint(max / header.step) : INFINITY;
+
+        if (multiples <= INT8_MAX)
+        {
+            header.format = COMPRESSED_INT8;
+
+            int8_t *q = (int8_t *)values;
+            for (long i = 0; i < n; i++)
+            {
+                q[i] = (int8_t)nearbyint(data[i] / header.step);
+            }
+        }
+        else if (multiples <= INT16_MAX)
+        {
+            header.format = COMPRESSED_INT16;
+
+            int16_t *q = (int16_t *)values;
+            for (long i = 0; i < n; i++)
+            {
+                q[i] = (int16_t)nearbyint(data[i] / header.step);
+            }
+        }
+        else if (multiples <= INT32_MAX)
+        {
+            header.format = COMPRESSED_INT32;
+
+            int32_t *q = (int32_t *)values;
+            for (long i = 0; i < n; i++)
+            {
+                q[i] = (int32_t)nearbyint(data[i] / header.step);
+            }
+        }
+        else
+        {
+            header.format = COMPRESSED_DOUBLE;
+            memcpy(values, data, sizeof(double) * n);
+        }
+    }
+
+    memcpy(packed, &header, sizeof(CompressedHeader));
+
+    return sizeof(CompressedHeader) + bytesPerValue(header.format) * n;
+}
+
+int decompressBlock(const char *packed, long n, double *data)
+{
+    CompressedHeader header;
+    const char *values = packed + sizeof(CompressedHeader);
+
+    memcpy(&header, packed, sizeof(CompressedHeader));
+
+    switch (header.format)
+    {
+    case COMPRESSED_FLOAT:
+        for (long i = 0; i < n; i++)
+        {
+            data[i] = ((const float *)values)[i];
+        }
+        break;
+    case COMPRESSED_INT8:
+        for (long i = 0; i < n; i++)
+        {
+            data[i] = ((const int8_t *)values)[i] * header.step;
+        }
+        break;
+    case COMPRESSED_INT16:
+        for (long i = 0; i < n; i++)
+        {
+            data[i] = ((const int16_t *)values)[i] * header.step;
+        }
+        break;
+    case COMPRESSED_INT32:
+        for (long i = 0; i < n; i++)
+        {
+            data[i] = ((const int32_t *)values)[i] * header.step;
+        }
+        break;
+    case COMPRESSED_DOUBLE:
+        memcpy(data, values, sizeof(double) * n);
+        break;
+    default:
+        return NOK;
+    }
+
+    return OK;
+}
@@ -0,0 +1,44 @@
+#ifndef __COMPRESSION_H__
+#define __COMPRESSION_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
+
+#include "util.h"
+
+/**
+ * Lossy compression of the M_k blocks sent around the ring (-z).
+ *
+ * COMPRESSION_FLOAT: every value is sent as a float, if the rounding
+ * error is within maxError.
+ *
+ * COMPRESSION_QUANTIZE: every value is rounded to a multiple of
+ * 2 * maxError and sent as the smallest integer (8, 16 or 32 bits) that
+ * holds all the multiples of the block, so the error is at most
+ * maxError. In the late terms most values are far below the tolerance
+ * and the blocks go out with one byte per value. Blocks with values too
+ * large for 32 bits are sent uncompressed.
+ *
+ * The packed block starts with a header with the format and step.
+ */
+
+/**
+ * Largest packed size (bytes) of a block with n values
+ */
+long maxCompressedSize(long n);
+
+/**
+ * Packs the n values of data. Returns the packed size in bytes.
+ */
+long compressBlock(const double *data, long n, int mode, double maxError, char *packed);
+
+/**
+ * Unpacks n values into data
+ */
+int decompressBlock(const char *packed, long n, double *data);
+
+#endif
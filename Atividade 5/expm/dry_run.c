@@ -0,0 +1,247 @@
+#include "dry_run.h"
+
+/**
+ * Takes a phase of the run into the peaks, per category and in total
+ */
+static void addPhase(long *peak, const long *phase)
+{
+    long total = 0;
+
+    for (int c = 0; c < MEMORY_N_CATEGORIES; c++)
+    {
+        peak[c] = phase[c] > peak[c] ? phase[c] : peak[c];
+        total += phase[c];
+    }
+
+    if (total > peak[MEMORY_N_CATEGORIES])
+    {
+        peak[MEMORY_N_CATEGORIES] = total;
+    }
+}
+
+/**
+ * Bytes of the background writer's copy of an n x n matrix (-W)
+ */
+static long snapshotBytes(const ParsedParams *params)
+{
+    long nRows = params->n > MAX_ROWS_TO_OUTPUT ? MAX_ROWS_TO_OUTPUT + 1 : params->n;
+    long nColumns = params->n > MAX_COLUMNS_TO_OUTPUT ? MAX_COLUMNS_TO_OUTPUT + 1 : params->n;
+
+    if (!params->asyncOutput)
+    {
+        return 0;
+    }
+
+    return sizeof(double) * (params->fullOutput ? params->n * params->n : nRows * nColumns);
+}
+
+/**
+ * singleProcess on top of base
+ */
+static void predictSingleProcess(const ParsedParams *params, const long *base, long *peak)
+{
+    long n = params->n;
+    long full = sizeof(double) * n * n;
+    long phase[MEMORY_N_CATEGORIES];
+
+    memcpy(phase, base, sizeof(phase));
+    addPhase(peak, phase);
+
+    // The small kernels don't need any buffers
+    if (hasSmallKernel(n) == OK && params->nTimes == 1 && params->times[0] == 1.0 &&
+        (params->strassenCutoff <= 0 || params->strassenCutoff > n))
+    {
+        return;
+    }
+
+    // multiplied
+    phase[MEMORY_MATRICES] += full;
+
+    if (params->strassenCutoff > 0)
+    {
+        // strassenError: classic and Strassen products of A * A
+        long check[MEMORY_N_CATEGORIES];
+
+        memcpy(check, phase, sizeof(check));
+        check[MEMORY_MATRICES] += 2 * full;
+        check[MEMORY_TEMPORARIES] += strassenTemporaryBytes(n, n, n, params->strassenCutoff);
+        addPhase(peak, check);
+    }
+
+    // The terms: M_k, zeroes and the Strassen temporaries
+    phase[MEMORY_MATRICES] += full;
+    phase[MEMORY_ZEROES] += full;
+    phase[MEMORY_TEMPORARIES] += strassenTemporaryBytes(n, n, n, params->strassenCutoff);
+    addPhase(peak, phase);
+}
+
+/**
+ * multiProcess on process myrank, on top of base
+ */
+static void predictMultiProcess(const ParsedParams *params, int npes, int myrank, const long *base, long *peak)
+{
+    long nColumns = calculateColumnsPerProcess(params->n, params->tiled ? npes * TILE_SIZE : npes);
+    long nRows = nColumns / npes;
+    long block = sizeof(double) * nRows * nColumns;
+    long cutoff = params->strassenCutoff;
+    long phase[MEMORY_N_CATEGORIES];
+    long setup[MEMORY_N_CATEGORIES];
+    long gather[MEMORY_N_CATEGORIES];
+
+    memcpy(phase, base, sizeof(phase));
+
+    // Transport: the M_k block and where the others' blocks arrive
+    if (params->transport == TRANSPORT_SHM)
+    {
+        phase[MEMORY_WINDOWS] += myrank == 0 ? npes * block : 0;
+    }
+    else if (params->transport == TRANSPORT_RMA)
+    {
+        phase[MEMORY_WINDOWS] += 2 * block;
+        phase[MEMORY_BUFFERS] += 2 * block;
+    }
+    else
+    {
+        phase[MEMORY_MATRICES] += block;
+        phase[MEMORY_BUFFERS] += block;
+    }
+
+    // Our rows of A and S (the S start on disk with -O)
+    phase[MEMORY_MATRICES] += params->scratch == NULL ? (1 + params->nTimes) * block : block;
+
+    // Setup: the tiled copy of A or the Strassen check on our leading
+    // square block
+    memcpy(setup, phase, sizeof(setup));
+
+    if (params->tiled && params->scratch == NULL)
+    {
+        setup[MEMORY_MATRICES] += block;
+    }
+
+    if (cutoff > 0)
+    {
+        setup[MEMORY_MATRICES] += 2 * sizeof(double) * nRows * nRows;
+        setup[MEMORY_TEMPORARIES] += strassenTemporaryBytes(nRows, nRows, nRows, cutoff);
+    }
+
+    addPhase(peak, setup);
+
+    if (params->scratch != NULL)
+    {
+        // A went to disk
+        phase[MEMORY_MATRICES] -= block;
+    }
+
+    // multiplied and zeroes (none out of core)
+    phase[MEMORY_MATRICES] += block;
+    phase[MEMORY_ZEROES] += params->scratch == NULL ? block : 0;
+
+    if (params->tiled && params->scratch == NULL)
+    {
+        // S is tiled and untiled through a copy too
+        memcpy(setup, phase, sizeof(setup));
+        setup[MEMORY_MATRICES] += block;
+        addPhase(peak, setup);
+    }
+
+    if (params->taskGraph)
+    {
+        // The task graph frees the ring's M_k block, receive buffer,
+        // multiplied and zeroes once they are set up
+        addPhase(peak, phase);
+
+        phase[MEMORY_MATRICES] -= 2 * block;
+        phase[MEMORY_BUFFERS] -= block;
+        phase[MEMORY_ZEROES] -= block;
+    }
+
+    // The gather of S needs a buffer when our blocks have padding
+    memcpy(gather, phase, sizeof(gather));
+
+    if (myrank == 0 && nColumns != params->n)
+    {
+        gather[MEMORY_BUFFERS] += block;
+    }
+
+    addPhase(peak, gather);
+
+    // The terms
+    if (params->taskGraph)
+    {
+        long width = TASK_GRAPH_TILE < nColumns ? TASK_GRAPH_TILE : nColumns;
+        long last = nColumns - (nColumns - 1) / width * width;
+        long full = strassenTemporaryBytes(nRows, nRows, width, cutoff);
+        long narrow = strassenTemporaryBytes(nRows, nRows, last, cutoff);
+
+        // Full M_k-1 and M_k
+        phase[MEMORY_MATRICES] += 2 * sizeof(double) * nColumns * nColumns;
+        phase[MEMORY_TEMPORARIES] += full > narrow ? full : narrow;
+    }
+    else if (params->transport == TRANSPORT_SHM)
+    {
+        phase[MEMORY_TEMPORARIES] += strassenTemporaryBytes(nRows, nColumns, nColumns, cutoff);
+    }
+    else
+    {
+        phase[MEMORY_TEMPORARIES] += strassenTemporaryBytes(nRows, nRows, nColumns, cutoff);
+    }
+
+    addPhase(peak, phase);
+}
+
+void predictMemory(const ParsedParams *params, int npes, long *first, long *others)
+{
+    long full = sizeof(double) * params->n * params->n;
+    long base[MEMORY_N_CATEGORIES] = { 0 };
+
+    for (int c = 0; c <= MEMORY_N_CATEGORIES; c++)
+    {
+        first[c] = others[c] = 0;
+    }
+
+    // Process #0: the full A and S (unless they are on disk) and the
+    // writer's copy of A
+    base[MEMORY_MATRICES] = (params->scratch == NULL ? (1 + params->nTimes) * full : 0) + snapshotBytes(params);
+
+    if (npes == 1 && !params->tiled)
+    {
+        predictSingleProcess(params, base, first);
+    }
+    else
+    {
+        predictMultiProcess(params, npes, 0, base, first);
+
+        base[MEMORY_MATRICES] = 0;
+        predictMultiProcess(params, npes, 1, base, others);
+    }
+
+    if (params->asyncOutput)
+    {
+        // Writing S in the background: A, S and the copies of all of them
+        long phase[MEMORY_N_CATEGORIES] = { 0 };
+
+        phase[MEMORY_MATRICES] = (1 + params->nTimes) * (full + snapshotBytes(params));
+        addPhase(first, phase);
+    }
+}
+
+void printMemoryPrediction(const ParsedParams *params, int npes)
+{
+    long first[MEMORY_N_CATEGORIES + 1];
+    long others[MEMORY_N_CATEGORIES + 1];
+
+    predictMemory(params, npes, first, others);
+
+    printf("Predicted memory high-water marks (MB) for n = %ld on %d processes: process #0, each of the others, sum of the processes\n",
+           params->n,
+           npes);
+
+    for (int c = 0; c <= MEMORY_N_CATEGORIES; c++)
+    {
+        printf("  %-12s %12.3f %12.3f %12.3f\n",
+               memoryCategoryName(c),
+               first[c] / 1e6,
+               others[c] / 1e6,
+               (first[c] + (npes - 1) * (double)others[c]) / 1e6);
+    }
+}
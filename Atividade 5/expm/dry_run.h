@@ -0,0 +1,36 @@
+#ifndef __DRY_RUN_H__
+#define __DRY_RUN_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "util.h"
+#include "matrix.h"
+#include "memory.h"
+#include "parse_param.h"
+#include "multi_process.h"
+#include "small_matrix.h"
+
+/**
+ * Memory prediction (--dry-run): the high-water marks that the memory
+ * accounting would report for params on npes processes, from the same
+ * data distribution as singleProcess / multiProcess.
+ *
+ * The run goes through phases (setup with the Strassen check or the
+ * tiled conversion, the terms, the gather of S) and the peak of each
+ * category, and of the total, is the largest over the phases.
+ * first gets the peaks of process #0, which also holds the full A and S,
+ * and others those of every other process (MEMORY_N_CATEGORIES + 1
+ * values each, the last one the total). With -c shm the window is
+ * allocated by the first process of each node: it's counted on
+ * process #0 only. The background writer (-W) is assumed to still hold
+ * its copy of A during the terms, so the prediction is an upper bound.
+ */
+void predictMemory(const ParsedParams *params, int npes, long *first, long *others);
+
+/**
+ * Prints the prediction of predictMemory
+ */
+void printMemoryPrediction(const ParsedParams *params, int npes);
+
+#endif
@@ -0,0 +1,161 @@
+#include "ensemble.h"
+
+Ensemble *readEnsemble(const char *filename, int myrank, MPI_Comm comm)
+{
+    Ensemble *e = (Ensemble *)malloc(sizeof(Ensemble));
+    int capacity = 16;
+
+    e->nProblems = 0;
+    e->seeds = NULL;
+    e->n = NULL;
+    e->outputs = NULL;
+
+    if (myrank == 0)
+    {
+        FILE *fp = fopen(filename, "r");
+        char line[ENSEMBLE_NAME_LENGTH + 64];
+        char output[ENSEMBLE_NAME_LENGTH];
+        char format[32];
+        int seed, end = 0;
+        long n;
+
+        // The name is read up to ENSEMBLE_NAME_LENGTH - 1 characters
+        snprintf(format, sizeof(format), "%%d %%ld %%%ds%%n", ENSEMBLE_NAME_LENGTH - 1);
+
+        e->seeds = (int *)malloc(sizeof(int) * capacity);
+        e->n = (long *)malloc(sizeof(long) * capacity);
+        e->outputs = (char *)malloc(ENSEMBLE_NAME_LENGTH * capacity);
+
+        while (fp != NULL && fgets(line, sizeof(line), fp) != NULL)
+        {
+            char *first = line;
+            while (isspace((unsigned char)*first))
+            {
+                first++;
+            }
+
+            // Blank lines and comments
+            if (*first == '\0' || *first == '#')
+            {
+                continue;
+            }
+
+            if (sscanf(line, format, &seed, &n, output, &end) != 3)
+            {
+                printf("[WARNING] Skipped invalid problem: %s", line);
+                continue;
+            }
+
+            if (line[end] != '\0' && !isspace((unsigned char)line[end]))
+            {
+                printf("[WARNING] Skipped problem with an output name of more than %d characters\n",
+                       ENSEMBLE_NAME_LENGTH - 1);
+                continue;
+            }
+
+            if (seed <= 0 || n <= 0)
+            {
+                printf("[WARNING] Skipped invalid problem: %s", line);
+                continue;
+            }
+
+            if (e->nProblems == capacity)
+            {
+                capacity *= 2;
+                e->seeds = (int *)realloc(e->seeds, sizeof(int) * capacity);
+                e->n = (long *)realloc(e->n, sizeof(long) * capacity);
+                e->outputs = (char *)realloc(e->outputs, ENSEMBLE_NAME_LENGTH * capacity);
+            }
+
+            e->seeds[e->nProblems] = seed;
+            e->n[e->nProblems] = n;
+            strcpy(e->outputs + e->nProblems * ENSEMBLE_NAME_LENGTH, output);
+            e->nProblems++;
+        }
+
+        if (fp != NULL)
+        {
+            fclose(fp);
+        }
+
+        // Nothing to solve is an error too
+        if (fp == NULL || e->nProblems == 0)
+        {
+            e->nProblems = -1;
+        }
+    }
+
+    MPI_Bcast(&e->nProblems, 1, MPI_INT, 0, comm);
+
+    if (e->nProblems < 0)
+    {
+        destroyEnsemble(e);
+        return NULL;
+    }
+
+    if (myrank != 0)
+    {
+        e->seeds = (int *)malloc(sizeof(int) * (e->nProblems + 1));
+        e->n = (long *)malloc(sizeof(long) * (e->nProblems + 1));
+        e->outputs = (char *)malloc(ENSEMBLE_NAME_LENGTH * (e->nProblems + 1));
+    }
+
+    MPI_Bcast(e->seeds, e->nProblems, MPI_INT, 0, comm);
+    MPI_Bcast(e->n, e->nProblems, MPI_LONG, 0, comm);
+    MPI_Bcast(e->outputs, e->nProblems * ENSEMBLE_NAME_LENGTH, MPI_CHAR, 0, comm);
+
+    return e;
+}
+
+void destroyEnsemble(Ensemble *e)
+{
+    if (e == NULL)
+    {
+        return;
+    }
+
+    free(e->seeds);
+    free(e->n);
+    free(e->outputs);
+    free(e);
+}
+
+EnsembleQueue *createEnsembleQueue(MPI_Comm comm)
+{
+    EnsembleQueue *q = (EnsembleQueue *)malloc(sizeof(EnsembleQueue));
+    int myrank = 0;
+
+    MPI_Comm_rank(comm, &myrank);
+
+    q->next = 0;
+
+    // Only process #0 holds the counter
+    MPI_Win_create(&q->next, myrank == 0 ? sizeof(long) : 0, sizeof(long), MPI_INFO_NULL, comm, &q->window);
+
+    return q;
+}
+
+long nextProblem(EnsembleQueue *q, MPI_Comm group)
+{
+    long index = 0, one = 1;
+    int grank = 0;
+
+    MPI_Comm_rank(group, &grank);
+
+    if (grank == 0)
+    {
+        MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, q->window);
+        MPI_Fetch_and_op(&one, &index, MPI_LONG, 0, 0, MPI_SUM, q->window);
+        MPI_Win_unlock(0, q->window);
+    }
+
+    MPI_Bcast(&index, 1, MPI_LONG, 0, group);
+
+    return index;
+}
+
+void destroyEnsembleQueue(EnsembleQueue *q)
+{
+    MPI_Win_free(&q->window);
+    free(q);
+}
@@ -0,0 +1,69 @@
+#ifndef __ENSEMBLE_H__
+#define __ENSEMBLE_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <mpi.h>
+
+#include "util.h"
+
+/**
+ * Ensemble mode (-E): many independent problems, each solved by a group
+ * of processes. MPI_COMM_WORLD is split into groups of groupSize
+ * consecutive ranks (the last one may be smaller) and the group leaders
+ * take the next problem from a shared counter on process #0
+ * (MPI_Fetch_and_op), so faster groups take more problems.
+ *
+ * The list file has one problem per line: seed n output-file.
+ * Empty lines and lines starting with # are skipped.
+ */
+typedef struct ensemble
+{
+    int nProblems;
+    int *seeds;
+    long *n;
+
+    /**
+     * ENSEMBLE_NAME_LENGTH characters per output file name
+     */
+    char *outputs;
+} Ensemble;
+
+/**
+ * Process #0 reads the list and sends it to everyone in comm.
+ * Lines that aren't a problem are skipped with a warning. Returns NULL
+ * (on every process) if it can't be read or has no problems.
+ */
+Ensemble *readEnsemble(const char *filename, int myrank, MPI_Comm comm);
+
+void destroyEnsemble(Ensemble *e);
+
+/**
+ * Shared counter of the next problem
+ */
+typedef struct ensemble_queue
+{
+    MPI_Win window;
+    long next;
+} EnsembleQueue;
+
+/**
+ * Must be called by every process of comm
+ */
+EnsembleQueue *createEnsembleQueue(MPI_Comm comm);
+
+/**
+ * Index of the next problem for our group. The group leader takes it
+ * from the queue and shares it with the group. Must be called by every
+ * process of group.
+ */
+long nextProblem(EnsembleQueue *q, MPI_Comm group);
+
+/**
+ * Must be called by every process of the communicator of the queue
+ */
+void destroyEnsembleQueue(EnsembleQueue *q);
+
+#endif
@@ -11,6 +11,332 @@
 #include "parse_param.h"
 #include "single_process.h"
 #include "multi_process.h"
+#include "fast_output.h"
+#include "async_writer.h"
+#include "planner.h"
+#include "perf_counters.h"
+#include "memory.h"
+#include "block_triangular.h"
+#include "topology.h"
+#include "out_of_core.h"
+#include "incremental.h"
+#include "cache.h"
+#include "ensemble.h"
+#include "dry_run.h"
+
+/**
+ * Writes m to the output file, in the background if there is a writer
+ */
+static int saveMatrix(const ParsedParams *params,
+                      AsyncWriter *writer,
+                      const char *name,
+                      const Matrix *m,
+                      int format,
+                      int append)
+{
+    if (writer != NULL)
+    {
+        return asyncWriteMatrix(writer,
+                                params->outputfile,
+                                name,
+                                m,
+                                format,
+                                append,
+                                params->fullOutput);
+    }
+
+    if (params->fullOutput)
+    {
+        return printFullMatrixToFile(params->outputfile, name, m, format, append);
+    }
+
+    return printMatrixToFile(params->outputfile, name, m, format, append);
+}
+
+/**
+ * s[i] = exp(t_i a) with the method chosen by the parameters.
+ * Must be called by every process of MPI_COMM_WORLD.
+ */
+static int computeExpm(ParsedParams *params, const Matrix *a, Matrix **s, int myrank, int nActive, MPI_Comm active)
+{
+    if (myrank >= nActive)
+    {
+        // Not needed by the plan
+        return OK;
+    }
+
+    if (params->blockTriangular)
+    {
+        return blockTriangularProcess(params, a, s, myrank, nActive, active);
+    }
+
+    if (nActive == 1 && !params->tiled)
+    {
+        //Single thread/process
+        return singleProcess(params, a, s);
+    }
+
+    return multiProcess(params, a, s, myrank, nActive, active);
+}
+
+/**
+ * computeExpm through the result cache (-C): process #0 looks A up and
+ * the computation only runs on a miss. Every process of everyone calls
+ * it, the first nActive of them are in active.
+ */
+static int cachedExpm(ParsedParams *params,
+                      const Matrix *a,
+                      Matrix **s,
+                      int myrank,
+                      int nActive,
+                      MPI_Comm active,
+                      MPI_Comm everyone)
+{
+    char key[CACHE_KEY_LENGTH + 1];
+    int hit = 0;
+
+    if (params->cacheDir == NULL)
+    {
+        return computeExpm(params, a, s, myrank, nActive, active);
+    }
+
+    if (myrank == 0)
+    {
+        cacheKey(params, a, key);
+        hit = cacheLoad(params, key, s) == OK;
+
+        printf("Cache %s: %s\n", hit ? "hit" : "miss", key);
+    }
+
+    MPI_Bcast(&hit, 1, MPI_INT, 0, everyone);
+
+    if (hit)
+    {
+        return OK;
+    }
+
+    int res = computeExpm(params, a, s, myrank, nActive, active);
+
+    if (myrank == 0 && res == OK && cacheStore(params, key, s) != OK)
+    {
+        printf("[WARNING] Could not add the result to the cache in %s\n", params->cacheDir);
+    }
+
+    return res;
+}
+
+/**
+ * Writes S, or the t values and every S_i, to the output file
+ */
+static void saveResult(const ParsedParams *params, AsyncWriter *writer, const char *name, Matrix **s)
+{
+    // With -U only exp(A) is written, the exp(A / 2^l) are ours
+    if (params->nTimes == 1 || params->updates > 0)
+    {
+        saveMatrix(params, writer, name, s[0], USE_LONG_FORMAT, APPEND_FILE);
+        return;
+    }
+
+    // t values followed by S_i = exp(t_i A)
+    Matrix times = { 1, params->nTimes, params->times };
+    char matrixName[32];
+
+    saveMatrix(params, writer, "t", &times, USE_LONG_FORMAT, APPEND_FILE);
+
+    for (int i = 0; i < params->nTimes; i++)
+    {
+        snprintf(matrixName, sizeof(matrixName), "%s_%d", name, i + 1);
+        saveMatrix(params, writer, matrixName, s[i], USE_LONG_FORMAT, APPEND_FILE);
+    }
+}
+
+/**
+ * Incremental steps (-U): A += D and the exp(A / 2^l) are updated on
+ * process #0, or recomputed by everyone when the estimated error of the
+ * updates since the last full computation goes over the tolerance.
+ * Every D has the same size, so once the estimate of a single update
+ * goes over the tolerance the updates are no longer tried.
+ */
+static int incrementalSteps(ParsedParams *params,
+                            AsyncWriter *writer,
+                            Matrix *a,
+                            Matrix **s,
+                            int myrank,
+                            int nActive,
+                            MPI_Comm active)
+{
+    double error = 0.0, estimate = 0.0, ti;
+    char name[32];
+    int res = OK;
+    int updating = 1;
+
+    for (int step = 1; step <= params->updates && res == OK; step++)
+    {
+        int recompute = 1;
+
+        ti = MPI_Wtime();
+
+        if (myrank == 0)
+        {
+            Delta *d = createRandomDelta(params->n, params->updateRank, params->updateSize);
+
+            if (updating)
+            {
+                estimate = frechetUpdate(s, params->nTimes - 1, d);
+
+                if (error + estimate <= params->tolerance)
+                {
+                    error += estimate;
+                    recompute = 0;
+                }
+                else if (estimate > params->tolerance)
+                {
+                    // Out of reach for this size of D: the next steps
+                    // go straight to the recomputation
+                    updating = 0;
+                    printf("Updates of size %e can't reach the tolerance: recomputing every step\n",
+                           params->updateSize);
+                }
+            }
+
+            addDelta(a, d);
+            destroyDelta(d);
+        }
+
+        MPI_Bcast(&recompute, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+        if (recompute)
+        {
+            res = cachedExpm(params, a, s, myrank, nActive, active, MPI_COMM_WORLD);
+            error = 0.0;
+        }
+
+        if (myrank == 0)
+        {
+            printf("Step %d: %s in %fs (estimated error %e)\n",
+                   step,
+                   recompute ? "recomputed" : "updated",
+                   MPI_Wtime() - ti,
+                   recompute ? estimate : error);
+
+            snprintf(name, sizeof(name), "A_step_%d", step);
+            saveMatrix(params, writer, name, a, USE_SHORT_FORMAT, APPEND_FILE);
+
+            snprintf(name, sizeof(name), "S_step_%d", step);
+            saveResult(params, writer, name, s);
+        }
+    }
+
+    return res;
+}
+
+/**
+ * Ensemble mode (-E): every group of processes takes problems from the
+ * queue and solves them until there are none left
+ */
+static int runEnsemble(ParsedParams *params, int myrank, int npes)
+{
+    Ensemble *e = readEnsemble(params->ensembleFile, myrank, MPI_COMM_WORLD);
+
+    if (e == NULL)
+    {
+        if (myrank == 0)
+        {
+            printf("[ERROR] Could not read any problem from the list %s\n", params->ensembleFile);
+        }
+        return NOK;
+    }
+
+    MPI_Comm group;
+    int grank = 0, gsize = 0;
+    long solved = 0;
+    int res = OK;
+
+    // Consecutive ranks share a node when they can
+    MPI_Comm_split(MPI_COMM_WORLD, myrank / params->groupSize, myrank, &group);
+    MPI_Comm_rank(group, &grank);
+    MPI_Comm_size(group, &gsize);
+
+    EnsembleQueue *q = createEnsembleQueue(MPI_COMM_WORLD);
+
+    double ti = MPI_Wtime();
+
+    for (long p = nextProblem(q, group); p < e->nProblems && res == OK; p = nextProblem(q, group))
+    {
+        ParsedParams problem = *params;
+        Matrix *a = NULL;
+        Matrix **s = NULL;
+
+        problem.seed = e->seeds[p];
+        problem.n = e->n[p];
+        problem.outputfile = e->outputs + p * ENSEMBLE_NAME_LENGTH;
+
+        if (grank == 0)
+        {
+            srand(problem.seed);
+
+            a = createMatrix(problem.n, problem.n);
+            fillMatrixWithRandom(a);
+
+            if (problem.density < 1.0)
+            {
+                sparsifyMatrix(a, problem.density);
+            }
+
+            s = (Matrix **)malloc(sizeof(Matrix *) * problem.nTimes);
+            for (int i = 0; i < problem.nTimes; i++)
+            {
+                s[i] = createMatrix(problem.n, problem.n);
+            }
+        }
+
+        double tp = MPI_Wtime();
+
+        res = cachedExpm(&problem, a, s, grank, gsize, group, group);
+
+        if (grank == 0)
+        {
+            printf("Problem %ld (n = %ld) on processes %d-%d: %fs\n",
+                   p + 1,
+                   problem.n,
+                   myrank,
+                   myrank + gsize - 1,
+                   MPI_Wtime() - tp);
+
+            saveMatrix(&problem, NULL, "A", a, USE_SHORT_FORMAT, OVERWRITE_FILE);
+            saveResult(&problem, NULL, "S", s);
+
+            destroyMatrix(a);
+            for (int i = 0; i < problem.nTimes; i++)
+            {
+                destroyMatrix(s[i]);
+            }
+            free(s);
+
+            solved++;
+        }
+    }
+
+    // Aggregate throughput
+    MPI_Reduce(myrank == 0 ? MPI_IN_PLACE : &solved, &solved, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (myrank == 0)
+    {
+        double elapsed = MPI_Wtime() - ti;
+
+        printf("Ensemble: %ld problems, %d groups, %fs (%f problems/s)\n",
+               solved,
+               (npes + params->groupSize - 1) / params->groupSize,
+               elapsed,
+               elapsed > 0.0 ? solved / elapsed : 0.0);
+    }
+
+    destroyEnsembleQueue(q);
+    MPI_Comm_free(&group);
+    destroyEnsemble(e);
+
+    return res;
+}
 
 int main(int argc, char *argv[])
 {
@@ -37,17 +363,31 @@ int main(int argc, char *argv[])
     /**
      * A matrix
      */
-    Matrix *a;
+    Matrix *a = NULL;
 
     /**
-     * S matrix
+     * S matrices, one per t
      */
-    Matrix *s;
+    Matrix **s = NULL;
+
+    /**
+     * Background writer for the output file (only on process #0)
+     */
+    AsyncWriter *writer = NULL;
 
     int res = NOK;
 
+    int provided = 0;
+
+    /**
+     * Processes that take part in the computation
+     */
+    MPI_Comm active = MPI_COMM_WORLD;
+    int nActive = 0;
+
     //Initialize MPI environment
-    if (MPI_Init(&argc, &argv) != MPI_SUCCESS)
+    //The output threads don't use MPI, only the main thread does
+    if (MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided) != MPI_SUCCESS)
     {
         printf("Error initializing MPI environment!\n");
         exit(1);
@@ -59,22 +399,150 @@ int main(int argc, char *argv[])
     // Parse command line arguments
     params = getParams(myrank, argc, argv);
 
+    // Predicted memory only
+    if (params.dryRun)
+    {
+        if (myrank == 0)
+        {
+            printMemoryPrediction(&params, params.dryRunProcesses > 0 ? params.dryRunProcesses : npes);
+        }
+
+        MPI_Finalize();
+        return 0;
+    }
+
+    perfInit(params.profile);
+    setMatrixBackend(params.backend);
+
+    // Pin the processes before any matrix is allocated, so the memory
+    // is first touched on the right NUMA node
+    if (params.numaAware)
+    {
+        Topology *topo = discoverTopology();
+        params.position = placeProcess(topo, myrank, MPI_COMM_WORLD);
+        destroyTopology(topo);
+    }
+
+    // The full output is formatted by as many threads as we have cpus,
+    // without taking the other processes' cores
+    setOutputThreads(cpusPerProcess(MPI_COMM_WORLD));
+
+    // Threads inside each process, on the cpus it was given
+    if (params.threads == 0)
+    {
+        params.threads = countAllowedCpus();
+    }
+
+    // Without MPI_THREAD_FUNNELED no other thread may run next to MPI:
+    // everything is done by the main thread
+    if (provided < MPI_THREAD_FUNNELED)
+    {
+        if (myrank == 0)
+        {
+            printf("[WARNING] The MPI library doesn't support threads: -W and -j are ignored\n");
+        }
+
+        params.asyncOutput = 0;
+        params.threads = 1;
+        setOutputThreads(1);
+    }
+
+#ifdef _OPENMP
+    omp_set_num_threads(params.threads);
+#else
+    if (params.threads > 1 && myrank == 0)
+    {
+        printf("[WARNING] Built without OpenMP: -j is ignored\n");
+    }
+#endif
+
+    if (params.ensembleFile != NULL)
+    {
+        res = runEnsemble(&params, myrank, npes);
+
+        perfReport(myrank, npes, MPI_COMM_WORLD);
+        memoryReport(myrank, npes, MPI_COMM_WORLD);
+
+        MPI_Finalize();
+        return res == OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     if (myrank == 0)
     {
         // Initialize random number generation
         srand(params.seed);
 
-        a = createMatrix(params.n, params.n);
-        s = createMatrix(params.n, params.n);
+        s = (Matrix **)malloc(sizeof(Matrix *) * params.nTimes);
+
+        if (params.scratch != NULL)
+        {
+            // The full matrices go to disk too
+            a = createScratchMatrix(params.scratch, params.n, params.n, 1);
+            int nCreated = 0;
+
+            while (a != NULL && nCreated < params.nTimes)
+            {
+                s[nCreated] = createScratchMatrix(params.scratch, params.n, params.n, 1);
+                if (s[nCreated] == NULL)
+                {
+                    break;
+                }
+                nCreated++;
+            }
+
+            if (nCreated < params.nTimes)
+            {
+                // Unmap what was created before giving up
+                destroyScratchMatrix(a);
+                for (int i = 0; i < nCreated; i++)
+                {
+                    destroyScratchMatrix(s[i]);
+                }
+                free(s);
+
+                printf("[ERROR] Could not create the files in %s\n", params.scratch);
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            }
+        }
+        else
+        {
+            a = createMatrix(params.n, params.n);
+            for (int i = 0; i < params.nTimes; i++)
+            {
+                s[i] = createMatrix(params.n, params.n);
+            }
+        }
 
         fillMatrixWithRandom(a);
 
+        if (params.density < 1.0)
+        {
+            sparsifyMatrix(a, params.density);
+        }
+
+        if (params.asyncOutput)
+        {
+            writer = createAsyncWriter();
+        }
+
         //save A matrix to file
-        printMatrixToFile(params.outputfile,
-                          "A",
-                          a,
-                          USE_SHORT_FORMAT,
-                          OVERWRITE_FILE);
+        saveMatrix(&params, writer, "A", a, USE_SHORT_FORMAT, OVERWRITE_FILE);
+    }
+
+    nActive = npes;
+
+    if (params.plan)
+    {
+        Plan plan = makePlan(&params, a, myrank, npes, MPI_COMM_WORLD);
+
+        // The first plan.npes processes do the work
+        nActive = plan.npes;
+        params.transport = plan.transport;
+
+        MPI_Comm_split(MPI_COMM_WORLD,
+                       myrank < nActive ? 0 : MPI_UNDEFINED,
+                       myrank,
+                       &active);
     }
 
     // Sync everyone
@@ -85,15 +553,7 @@ int main(int argc, char *argv[])
         ti = MPI_Wtime();
     }
 
-    if (npes == 1)
-    {
-        //Single thread/process
-        res = singleProcess(&params, a, s);
-    }
-    else
-    {
-        res = multiProcess(&params, a, s, myrank, npes);
-    }
+    res = cachedExpm(&params, a, s, myrank, nActive, active, MPI_COMM_WORLD);
 
     if (res == OK)
     {
@@ -105,11 +565,13 @@ int main(int argc, char *argv[])
             /* Elapsed time */
             printf("Elapsed time: %fs\n", tf - ti);
 
-            printMatrixToFile(params.outputfile,
-                              "S",
-                              s,
-                              USE_LONG_FORMAT,
-                              APPEND_FILE);
+            saveResult(&params, writer, "S", s);
+        }
+
+        // A changes and exp(A) follows
+        if (params.updates > 0)
+        {
+            res = incrementalSteps(&params, writer, a, s, myrank, nActive, active);
         }
     }
     else
@@ -118,12 +580,58 @@ int main(int argc, char *argv[])
         // AHHH SOMETHING NOK!
     }
 
+    // Hardware counters of each process (-p)
+    perfReport(myrank, npes, MPI_COMM_WORLD);
+
+    // Cross-check of the cblas backend (-b check)
+    if (params.backend == BACKEND_CHECK)
+    {
+        double difference = backendDifference();
+        double maxDifference = 0.0;
+
+        MPI_Reduce(&difference, &maxDifference, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+        if (myrank == 0)
+        {
+            printf("Largest relative difference between the built-in and cblas kernels: %g\n", maxDifference);
+        }
+    }
+
     if (myrank == 0)
     {
-        destroyMatrix(a);
-        destroyMatrix(s);
+        // Wait for the background writes
+        if (destroyAsyncWriter(writer) != OK)
+        {
+            printf("[ERROR] Error writing the output file!\n");
+        }
+
+        if (params.scratch != NULL)
+        {
+            destroyScratchMatrix(a);
+            for (int i = 0; i < params.nTimes; i++)
+            {
+                destroyScratchMatrix(s[i]);
+            }
+        }
+        else
+        {
+            destroyMatrix(a);
+            for (int i = 0; i < params.nTimes; i++)
+            {
+                destroyMatrix(s[i]);
+            }
+        }
+        free(s);
+    }
+
+    if (active != MPI_COMM_WORLD && active != MPI_COMM_NULL)
+    {
+        MPI_Comm_free(&active);
     }
 
+    // High-water marks of the matrices and buffers of each process
+    memoryReport(myrank, npes, MPI_COMM_WORLD);
+
     MPI_Finalize();
     return 0;
 }
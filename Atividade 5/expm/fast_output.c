@@ -0,0 +1,306 @@
+#include "fast_output.h"
+
+/**
+ * Work for each formatting thread
+ */
+typedef struct format_job
+{
+    const Matrix *m;
+    int format;
+    long startRow;
+    long endRow;
+    char *buffer;
+    long length;
+} FormatJob;
+
+/**
+ * Writes the digits of value (at least nDigits) and returns the
+ * number of chars
+ */
+static int writeDigits(char *buffer, unsigned long long value, int nDigits)
+{
+    char digits[24];
+    int n = 0;
+
+    do
+    {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0 || n < nDigits);
+
+    for (int i = 0; i < n; i++)
+    {
+        buffer[i] = digits[n - 1 - i];
+    }
+
+    return n;
+}
+
+/**
+ * Right aligns the n chars in tmp to width, with a leading space
+ */
+static int writePadded(char *buffer, const char *tmp, int n, int width)
+{
+    int pos = 0;
+
+    buffer[pos++] = ' ';
+    while (n + pos - 1 < width)
+    {
+        buffer[pos++] = ' ';
+    }
+
+    memcpy(buffer + pos, tmp, n);
+
+    return pos + n;
+}
+
+/**
+ * Powers of 10 from 10^-POWERS_OFFSET to 10^POWERS_OFFSET.
+ * powl is too slow to call for every value.
+ */
+#define POWERS_OFFSET 320
+static long double powersOf10[2 * POWERS_OFFSET + 1];
+static pthread_once_t powersOnce = PTHREAD_ONCE_INIT;
+
+static void initPowersOf10(void)
+{
+    for (int i = -POWERS_OFFSET; i <= POWERS_OFFSET; i++)
+    {
+        powersOf10[i + POWERS_OFFSET] = powl(10.0L, i);
+    }
+}
+
+/**
+ * Rounds x to the nearest integer.
+ * Returns NOK if x is too close to a tie to be sure we round like printf.
+ */
+static int roundScaled(long double x, unsigned long long *q)
+{
+    long double fraction = x - floorl(x);
+
+    if (fabsl(fraction - 0.5L) < 1e-9L)
+    {
+        return NOK;
+    }
+
+    *q = (unsigned long long)rintl(x);
+
+    return OK;
+}
+
+int formatDouble(char *buffer, double v, int format)
+{
+    char tmp[32];
+    int n = 0;
+    unsigned long long q = 0;
+    long double a = fabsl((long double)v);
+
+    if (!isfinite(v) || a >= 1e14L || (a != 0 && a < 1e-280L))
+    {
+        // Leave the hard cases to printf
+        return sprintf(buffer, format == USE_LONG_FORMAT ? LONG_FORMAT : SHORT_FORMAT, v);
+    }
+
+    if (signbit(v))
+    {
+        tmp[n++] = '-';
+    }
+
+    if (format == USE_LONG_FORMAT)
+    {
+        // d.dddde+xx
+        int e = 0;
+
+        if (a != 0)
+        {
+            pthread_once(&powersOnce, initPowersOf10);
+
+            e = (int)floor(log10(fabs(v)));
+
+            if (roundScaled(a * powersOf10[POWERS_OFFSET + 4 - e], &q) != OK)
+            {
+                return sprintf(buffer, LONG_FORMAT, v);
+            }
+
+            // log10 may be off by one near the powers of 10
+            if (q >= 100000 || q < 10000)
+            {
+                e += q >= 100000 ? 1 : -1;
+
+                if (roundScaled(a * powersOf10[POWERS_OFFSET + 4 - e], &q) != OK)
+                {
+                    return sprintf(buffer, LONG_FORMAT, v);
+                }
+            }
+        }
+
+        tmp[n++] = '0' + q / 10000;
+        tmp[n++] = '.';
+        n += writeDigits(tmp + n, q % 10000, 4);
+        tmp[n++] = 'e';
+        tmp[n++] = e < 0 ? '-' : '+';
+        n += writeDigits(tmp + n, e < 0 ? -e : e, 2);
+
+        return writePadded(buffer, tmp, n, 11);
+    }
+
+    // d.dddd
+    if (roundScaled(a * 1e4L, &q) != OK)
+    {
+        return sprintf(buffer, SHORT_FORMAT, v);
+    }
+
+    n += writeDigits(tmp + n, q / 10000, 1);
+    tmp[n++] = '.';
+    n += writeDigits(tmp + n, q % 10000, 4);
+
+    return writePadded(buffer, tmp, n, 7);
+}
+
+static void *formatRows(void *arg)
+{
+    FormatJob *job = (FormatJob *)arg;
+    const Matrix *m = job->m;
+    char *p = job->buffer;
+
+    for (long i = job->startRow; i < job->endRow; i++)
+    {
+        for (long j = 0; j < m->nColumns; j++)
+        {
+            p += formatDouble(p, m->data[i * m->nColumns + j], job->format);
+        }
+        *(p++) = '\n';
+    }
+
+    job->length = p - job->buffer;
+
+    return NULL;
+}
+
+/**
+ * write() until everything is written
+ */
+static int writeAll(int fd, const char *buffer, long length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, buffer, length);
+        if (written < 0)
+        {
+            return NOK;
+        }
+
+        buffer += written;
+        length -= written;
+    }
+
+    return OK;
+}
+
+/**
+ * Formatting threads (setOutputThreads)
+ */
+static int outputThreads = 1;
+
+void setOutputThreads(int nThreads)
+{
+    outputThreads = nThreads > 0 ? nThreads : 1;
+}
+
+int printFullMatrixToFile(const char *filename,
+                          const char *name,
+                          const Matrix *m,
+                          int format,
+                          int append)
+{
+    char header[256];
+    int res = OK;
+
+    int fd = open(filename,
+                  O_WRONLY | O_CREAT | (append == APPEND_FILE ? O_APPEND : O_TRUNC),
+                  0644);
+
+    if (fd < 0)
+    {
+        printf("[ERROR] Error opening file for writing!\n");
+        return NOK;
+    }
+
+    if (name != NULL)
+    {
+        res = writeAll(fd, header, snprintf(header, sizeof(header), "\n%s=[\n", name));
+    }
+
+    long nThreads = outputThreads;
+
+    // Each thread formats rowsPerJob rows at a time in its own buffer
+    long rowLength = m->nColumns * MAX_FORMATTED_DOUBLE + 1;
+    long rowsPerJob = OUTPUT_BUFFER_SIZE / rowLength;
+    if (rowsPerJob < 1)
+    {
+        rowsPerJob = 1;
+    }
+
+    FormatJob *jobs = (FormatJob *)malloc(sizeof(FormatJob) * nThreads);
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * nThreads);
+
+    for (long t = 0; t < nThreads; t++)
+    {
+        jobs[t].m = m;
+        jobs[t].format = format;
+        jobs[t].buffer = (char *)malloc(rowLength * rowsPerJob);
+    }
+
+    for (long row = 0; row < m->nRows && res == OK; row += rowsPerJob * nThreads)
+    {
+        for (long t = 0; t < nThreads; t++)
+        {
+            jobs[t].startRow = row + t * rowsPerJob;
+            jobs[t].endRow = jobs[t].startRow + rowsPerJob;
+
+            if (jobs[t].startRow > m->nRows)
+            {
+                jobs[t].startRow = m->nRows;
+            }
+
+            if (jobs[t].endRow > m->nRows)
+            {
+                jobs[t].endRow = m->nRows;
+            }
+
+            pthread_create(&threads[t], NULL, formatRows, &jobs[t]);
+        }
+
+        // The buffers are written in order
+        for (long t = 0; t < nThreads; t++)
+        {
+            pthread_join(threads[t], NULL);
+
+            if (res == OK)
+            {
+                res = writeAll(fd, jobs[t].buffer, jobs[t].length);
+            }
+        }
+    }
+
+    if (res == OK)
+    {
+        res = writeAll(fd, "];\n", 3);
+    }
+
+    if (res != OK)
+    {
+        printf("[ERROR] Error writing to file!\n");
+    }
+
+    for (long t = 0; t < nThreads; t++)
+    {
+        free(jobs[t].buffer);
+    }
+    free(jobs);
+    free(threads);
+
+    close(fd);
+
+    return res;
+}
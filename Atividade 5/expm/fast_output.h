@@ -0,0 +1,38 @@
+#ifndef __FAST_OUTPUT_H__
+#define __FAST_OUTPUT_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "matrix.h"
+
+/**
+ * Number of formatting threads of printFullMatrixToFile (1 by default).
+ * Each one has an OUTPUT_BUFFER_SIZE buffer.
+ */
+void setOutputThreads(int nThreads);
+
+/**
+ * Writes the full matrix (no MAX_ROWS_TO_OUTPUT / MAX_COLUMNS_TO_OUTPUT
+ * limits) using the same text format as printMatrixToFile.
+ * The rows are formatted by several threads into large buffers that
+ * are written with a few write calls.
+ */
+int printFullMatrixToFile(const char *filename,
+                          const char *name,
+                          const Matrix *m,
+                          int format,
+                          int append);
+
+/**
+ * Formats v like printf(SHORT_FORMAT / LONG_FORMAT, v) into buffer.
+ * Returns the number of chars written (no '\0' is added).
+ */
+int formatDouble(char *buffer, double v, int format);
+
+#endif
@@ -0,0 +1,186 @@
+#include "incremental.h"
+
+/**
+ * New matrix with a * b
+ */
+static Matrix *product(const Matrix *a, const Matrix *b)
+{
+    Matrix *c = createMatrixFilledWithZeros(a->nRows, b->nColumns);
+
+    multiplyMatrixAndSumBlock(a, b, c, 0, 0, 0, 0, 0, 0, a->nRows, a->nColumns, b->nColumns);
+
+    return c;
+}
+
+/**
+ * M * D
+ */
+static Matrix *timesDelta(const Matrix *m, const Delta *d)
+{
+    if (d->vt == NULL)
+    {
+        return product(m, d->u);
+    }
+
+    Matrix *mu = product(m, d->u);
+    Matrix *res = product(mu, d->vt);
+    destroyMatrix(mu);
+
+    return res;
+}
+
+/**
+ * D * M
+ */
+static Matrix *deltaTimes(const Delta *d, const Matrix *m)
+{
+    if (d->vt == NULL)
+    {
+        return product(d->u, m);
+    }
+
+    Matrix *vm = product(d->vt, m);
+    Matrix *res = product(d->u, vm);
+    destroyMatrix(vm);
+
+    return res;
+}
+
+Delta *createRandomDelta(long n, long rank, double size)
+{
+    Delta *d = (Delta *)malloc(sizeof(Delta));
+
+    d->u = createMatrix(n, rank > 0 ? rank : n);
+    d->vt = rank > 0 ? createMatrix(rank, n) : NULL;
+
+    fillMatrixWithRandom(d->u);
+    for (long i = 0; i < d->u->nRows * d->u->nColumns; i++)
+    {
+        d->u->data[i] *= size;
+    }
+
+    if (d->vt != NULL)
+    {
+        fillMatrixWithRandom(d->vt);
+        for (long i = 0; i < d->vt->nRows * d->vt->nColumns; i++)
+        {
+            d->vt->data[i] *= size;
+        }
+    }
+
+    return d;
+}
+
+void destroyDelta(Delta *d)
+{
+    if (d == NULL)
+    {
+        return;
+    }
+
+    destroyMatrix(d->u);
+    destroyMatrix(d->vt);
+    free(d);
+}
+
+int addDelta(Matrix *a, const Delta *d)
+{
+    if (d->vt == NULL)
+    {
+        return sumMatrix(d->u, a);
+    }
+
+    return multiplyMatrixAndSumBlock(d->u, d->vt, a, 0, 0, 0, 0, 0, 0, a->nRows, d->u->nColumns, a->nColumns);
+}
+
+double frechetUpdate(Matrix **expA, int nLevels, const Delta *d)
+{
+    long n = expA[0]->nRows;
+    long length = n * expA[0]->nColumns;
+
+    // Simpson's rule at the bottom level, where A is small:
+    // L(B, F) with B = A / 2^bottom and F = D / 2^bottom
+    int bottom = nLevels - 1;
+    Matrix *expB = expA[bottom];
+    Matrix *expHalfB = expA[nLevels];
+    double scale = ldexp(1.0, -bottom);
+
+    // Midpoint: exp(B/2) D exp(B/2)
+    Matrix *midpoint;
+    Matrix *halfD = timesDelta(expHalfB, d);
+    Matrix *dHalf = deltaTimes(d, expHalfB);
+
+    if (d->vt == NULL)
+    {
+        midpoint = product(halfD, expHalfB);
+    }
+    else
+    {
+        // (exp(B/2) u) (vt exp(B/2)): n x r x n
+        Matrix *hu = product(expHalfB, d->u);
+        Matrix *vh = product(d->vt, expHalfB);
+        midpoint = product(hu, vh);
+        destroyMatrix(hu);
+        destroyMatrix(vh);
+    }
+
+    // Ends: exp(B) D and D exp(B)
+    Matrix *left = timesDelta(expB, d);
+    Matrix *right = deltaTimes(d, expB);
+
+    // L(A / 2^l, D / 2^l), from the bottom level up
+    Matrix *frechet = createMatrix(n, expB->nColumns);
+    double difference = 0.0;
+
+    for (long i = 0; i < length; i++)
+    {
+        double trapezoid = (left->data[i] + right->data[i]) / 2.0;
+        double simpson = (4.0 * midpoint->data[i] + 2.0 * trapezoid) / 6.0;
+
+        difference = fmax(difference, fabs(simpson - midpoint->data[i]));
+
+        frechet->data[i] = simpson * scale;
+
+        // L(B/2, F/2) with the trapezoidal rule for the last level
+        expHalfB->data[i] += (halfD->data[i] + dHalf->data[i]) * scale / 4.0;
+    }
+
+    // Relative error at the bottom. Simpson's rule is usually much
+    // better than the midpoint rule, so this is on the safe side.
+    double relative = difference * scale / maxMij(frechet);
+
+    destroyMatrix(midpoint);
+    destroyMatrix(halfD);
+    destroyMatrix(dHalf);
+    destroyMatrix(left);
+    destroyMatrix(right);
+
+    // exp(2X) = exp(X)^2, so L(2X, 2F) = exp(X) L(X, F) + L(X, F) exp(X).
+    // Each level is updated once the one above has used it.
+    for (int l = bottom - 1; l >= 0; l--)
+    {
+        Matrix *next = createMatrixFilledWithZeros(n, n);
+
+        multiplyMatrixAndSumBlock(expA[l + 1], frechet, next, 0, 0, 0, 0, 0, 0, n, n, n);
+        multiplyMatrixAndSumBlock(frechet, expA[l + 1], next, 0, 0, 0, 0, 0, 0, n, n, n);
+
+        sumMatrix(frechet, expA[l + 1]);
+
+        destroyMatrix(frechet);
+        frechet = next;
+    }
+
+    sumMatrix(frechet, expA[0]);
+
+    // The doubling products carry the relative error unchanged
+    double error = relative * maxMij(frechet);
+
+    // Second order term, from L(A, D) D / 2 (exact when A and D commute)
+    Matrix *secondOrder = timesDelta(frechet, d);
+    error += maxMij(secondOrder) / 2.0;
+
+    destroyMatrix(secondOrder);
+    destroyMatrix(frechet);
+
+    return error;
+}
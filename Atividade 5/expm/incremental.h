@@ -0,0 +1,61 @@
+#ifndef __INCREMENTAL_H__
+#define __INCREMENTAL_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "util.h"
+#include "matrix.h"
+
+/**
+ * Incremental exp(A) for a sequence A, A + D_1, A + D_1 + D_2, ... (-U).
+ *
+ * exp(A + D) ~ exp(A) + L(A, D), where the Frechet derivative
+ * L(A, D) = int_0^1 exp(sA) D exp((1-s)A) ds
+ * is integrated with Simpson's rule at the bottom level
+ * B = A / 2^(UPDATE_LEVELS - 1), where exp(sB) varies little, and
+ * brought up with L(2B, 2F) = exp(B) L(B, F) + L(B, F) exp(B).
+ * exp(A / 2^l) for l = 0..UPDATE_LEVELS are kept from the previous step
+ * and updated with the L of their level; the first ones come from the
+ * same Taylor terms as exp(A) (t = 1, 1/2, 1/4...).
+ * A step costs 2 * UPDATE_LEVELS + 4 products, or
+ * 2 * (UPDATE_LEVELS - 1) when D is low rank (the others are n x n x r).
+ *
+ * The error estimate is the difference between Simpson's and the
+ * midpoint rule at the bottom level, relative to L, plus the second
+ * order term from L(A, D) D / 2 (exact when A and D commute).
+ * The estimates add up over the steps and the caller recomputes
+ * exp(A) from scratch when the sum goes over the tolerance.
+ */
+
+/**
+ * D = u * vt (low rank, u is n x r and vt r x n) or D = u (vt NULL)
+ */
+typedef struct delta
+{
+    Matrix *u;
+    Matrix *vt;
+} Delta;
+
+/**
+ * Random D with values in [-size, size] (rank 0: dense), or the product
+ * of two random factors with values in [-size, size]
+ */
+Delta *createRandomDelta(long n, long rank, double size);
+
+void destroyDelta(Delta *d);
+
+/**
+ * a += D
+ */
+int addDelta(Matrix *a, const Delta *d);
+
+/**
+ * Updates expA[l] = exp(A / 2^l), l = 0..nLevels, to exp((A + D) / 2^l).
+ * Returns the error estimate: if it is too large the expA must be
+ * recomputed.
+ */
+double frechetUpdate(Matrix **expA, int nLevels, const Delta *d);
+
+#endif
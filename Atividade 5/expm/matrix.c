@@ -1,6 +1,155 @@
 #include "matrix.h"
+#include "perf_counters.h"
+#include "memory.h"
+
+/**
+ * Backend of the kernels (-b)
+ */
+static int backend = BACKEND_BUILTIN;
+
+/**
+ * Largest relative difference found by BACKEND_CHECK
+ */
+static double difference = 0.0;
+
+void setMatrixBackend(int b)
+{
+    backend = b;
+}
+
+double backendDifference()
+{
+    return difference;
+}
+
+#ifdef USE_CBLAS
+/**
+ * If the sizes fit in the int arguments of cblas
+ */
+static int blasFits(long l, long m, long n)
+{
+    return backend != BACKEND_BUILTIN && l <= INT_MAX && m <= INT_MAX && n <= INT_MAX;
+}
+
+/**
+ * Records the difference between the built-in and the cblas result
+ */
+static void recordDifference(double builtin, double blas, double max)
+{
+    double d = fabs(builtin - blas) / (max > 0.0 ? max : 1.0);
+
+    if (d > difference)
+    {
+        difference = d;
+    }
+}
+
+/**
+ * Copy of the nRows x nColumns block of m at (row, column), where cblas
+ * writes its result in BACKEND_CHECK
+ */
+static double *copyBlock(const Matrix *m, long row, long column, long nRows, long nColumns)
+{
+    double *block = (double *)malloc(sizeof(double) * nRows * nColumns);
+
+    for (long i = 0; i < nRows; i++)
+    {
+        memcpy(block + i * nColumns, &m->data[(row + i) * m->nColumns + column], sizeof(double) * nColumns);
+    }
+
+    return block;
+}
+
+/**
+ * Compares the block computed by cblas with the built-in result in m
+ * and frees it
+ */
+static void compareBlock(double *block, const Matrix *m, long row, long column, long nRows, long nColumns)
+{
+    double max = 0.0;
+
+    if (block == NULL)
+    {
+        return;
+    }
+
+    for (long i = 0; i < nRows * nColumns; i++)
+    {
+        max = fmax(max, fabs(m->data[(row + i / nColumns) * m->nColumns + column + i % nColumns]));
+    }
+
+    for (long i = 0; i < nRows * nColumns; i++)
+    {
+        recordDifference(m->data[(row + i / nColumns) * m->nColumns + column + i % nColumns], block[i], max);
+    }
+
+    free(block);
+}
+
+/**
+ * C = A * B + beta * C for the l x m block of a at (arow, acol) and the
+ * m x n block of b at (brow, bcol), C the l x n block of c at
+ * (crow, ccol).
+ * Returns NOK if the built-in kernel must be used. In BACKEND_CHECK the
+ * result goes to a copy of C, returned in check, and the built-in kernel
+ * must run too.
+ */
+static int blasMultiply(const Matrix *a,
+                        const Matrix *b,
+                        Matrix *c,
+                        long arow,
+                        long acol,
+                        long brow,
+                        long bcol,
+                        long crow,
+                        long ccol,
+                        long l,
+                        long m,
+                        long n,
+                        double beta,
+                        double **check)
+{
+    *check = NULL;
+
+    if (!blasFits(l, m, n) || !blasFits(a->nColumns, b->nColumns, c->nColumns))
+    {
+        return NOK;
+    }
+
+    double *cptr = &c->data[crow * c->nColumns + ccol];
+    long ldc = c->nColumns;
+
+    if (backend == BACKEND_CHECK)
+    {
+        *check = cptr = copyBlock(c, crow, ccol, l, n);
+        ldc = n;
+    }
+
+    cblas_dgemm(CblasRowMajor,
+                CblasNoTrans,
+                CblasNoTrans,
+                (int)l,
+                (int)n,
+                (int)m,
+                1.0,
+                &a->data[arow * a->nColumns + acol],
+                (int)a->nColumns,
+                &b->data[brow * b->nColumns + bcol],
+                (int)b->nColumns,
+                beta,
+                cptr,
+                (int)ldc);
+
+    return OK;
+}
+#endif
 
 Matrix *createMatrix(long nRows, long nColumns)
+{
+    return createMatrixInCategory(nRows, nColumns, MEMORY_MATRICES);
+}
+
+Matrix *createMatrixInCategory(long nRows, long nColumns, int category)
 {
     Matrix *m;
 
@@ -8,7 +157,7 @@ Matrix *createMatrix(long nRows, long nColumns)
     m->nColumns = nColumns;
     m->nRows = nRows;
 
-    m->data = (double *)malloc(sizeof(double) * nRows * nColumns);
+    m->data = (double *)allocateTracked(sizeof(double) * nRows * nColumns, category);
 
     return m;
 }
@@ -30,7 +179,7 @@ void destroyMatrix(Matrix *m)
 
     if (m->data != NULL)
     {
-        free(m->data);
+        freeTracked(m->data);
     }
 
     free(m);
@@ -61,6 +210,20 @@ double maxMij(const Matrix *m)
     double max = fabs(m->data[0]);
     double v = 0.0;
 
+#ifdef USE_CBLAS
+    double blasMax = 0.0;
+
+    if (blasFits(m->nRows * m->nColumns, 1, 1))
+    {
+        blasMax = fabs(m->data[cblas_idamax((int)(m->nRows * m->nColumns), m->data, 1)]);
+
+        if (backend == BACKEND_CBLAS)
+        {
+            return blasMax;
+        }
+    }
+#endif
+
     for (long i = 1; i < m->nRows * m->nColumns; i++)
     {
         v = fabs(m->data[i]);
@@ -70,9 +233,89 @@ double maxMij(const Matrix *m)
         }
     }
 
+#ifdef USE_CBLAS
+    if (blasFits(m->nRows * m->nColumns, 1, 1))
+    {
+        recordDifference(max, blasMax, max);
+    }
+#endif
+
+    return max;
+}
+
+double maxRowSum(const Matrix *m)
+{
+    double max = 0.0;
+
+    for (long i = 0; i < m->nRows; i++)
+    {
+        double sum = 0.0;
+        for (long j = 0; j < m->nColumns; j++)
+        {
+            sum += fabs(m->data[i * m->nColumns + j]);
+        }
+
+        if (sum > max)
+        {
+            max = sum;
+        }
+    }
+
+    return max;
+}
+
+int addColumnSums(const Matrix *m, double *sums)
+{
+    for (long i = 0; i < m->nRows; i++)
+    {
+        for (long j = 0; j < m->nColumns; j++)
+        {
+            sums[j] += fabs(m->data[i * m->nColumns + j]);
+        }
+    }
+
+    return OK;
+}
+
+double maxColumnSum(const Matrix *m)
+{
+    double max = 0.0;
+    double *sums = (double *)malloc(sizeof(double) * m->nColumns);
+
+    fillArrayWithZeros(sums, m->nColumns);
+    addColumnSums(m, sums);
+
+    for (long j = 0; j < m->nColumns; j++)
+    {
+        if (sums[j] > max)
+        {
+            max = sums[j];
+        }
+    }
+
+    free(sums);
+
     return max;
 }
 
+long termsForTolerance(double norm, double tolerance)
+{
+    long k = 2;
+
+    if (norm <= 0.0)
+    {
+        return k;
+    }
+
+    // ||A||^k / k! in log space, it overflows for large norms
+    while (k * log(norm) - lgamma(k + 1.0) > log(tolerance))
+    {
+        k++;
+    }
+
+    return k;
+}
+
 int fillMatrixWithRandom(Matrix *a)
 {
     return fillArrayWithRandom(a->data, a->nColumns * a->nRows);
@@ -83,6 +326,19 @@ int fillMatrixWithZeros(Matrix *a)
     return fillArrayWithZeros(a->data, a->nColumns * a->nRows);
 }
 
+int sparsifyMatrix(Matrix *a, double density)
+{
+    for (long i = 0; i < a->nRows * a->nColumns; i++)
+    {
+        if ((double)rand() / RAND_MAX >= density)
+        {
+            a->data[i] = 0.0;
+        }
+    }
+
+    return OK;
+}
+
 int fillArrayWithRandom(double *a, long n)
 {
     for (long i = 0; i < n; i++)
@@ -103,14 +359,65 @@ int fillArrayWithZeros(double *a, long n)
 
 int sumMatrix(const Matrix *m, Matrix *s)
 {
-    for (long i = 0; i < s->nRows * s->nColumns; i++)
+    return sumScaledMatrix(m, 1.0, s);
+}
+
+int sumScaledMatrix(const Matrix *m, double factor, Matrix *s)
+{
+    long length = s->nRows * s->nColumns;
+
+#ifdef USE_CBLAS
+    double *check = NULL;
+
+    if (blasFits(length, 1, 1))
+    {
+        if (backend == BACKEND_CBLAS)
+        {
+            cblas_daxpy((int)length, factor, m->data, 1, s->data, 1);
+            return OK;
+        }
+
+        check = copyBlock(s, 0, 0, s->nRows, s->nColumns);
+        cblas_daxpy((int)length, factor, m->data, 1, check, 1);
+    }
+#endif
+
+    for (long i = 0; i < length; i++)
     {
-        s->data[i] += m->data[i];
+        s->data[i] += factor * m->data[i];
     }
 
+#ifdef USE_CBLAS
+    compareBlock(check, s, 0, 0, s->nRows, s->nColumns);
+#endif
+
     return OK;
 }
 
+double sumTaylorTerm(const Matrix *m, Matrix **s, const double *times, double *powers, int nTimes)
+{
+    double scale = 0.0;
+    double length = (double)m->nRows * m->nColumns;
+
+    perfStart(PERF_KERNEL_SUM);
+
+    for (int i = 0; i < nTimes; i++)
+    {
+        powers[i] *= times[i];
+        sumScaledMatrix(m, powers[i], s[i]);
+
+        if (fabs(powers[i]) > scale)
+        {
+            scale = fabs(powers[i]);
+        }
+    }
+
+    // Read M_k and read and write each S
+    perfStop(PERF_KERNEL_SUM, 2.0 * length * nTimes, sizeof(double) * length * (1 + 2 * nTimes));
+
+    return scale;
+}
+
 int setIdentityMatrix(Matrix *s)
 {
     return setIdentitySubMatrix(s, 0, 0);
@@ -149,6 +456,16 @@ int multiplyMatrix(const Matrix *a, const Matrix *b, Matrix *multiplied)
         return NOK;
     }
 
+#ifdef USE_CBLAS
+    double *check = NULL;
+
+    if (blasMultiply(a, b, multiplied, 0, 0, 0, 0, 0, 0, a->nRows, a->nColumns, b->nColumns, 0.0, &check) == OK &&
+        check == NULL)
+    {
+        return OK;
+    }
+#endif
+
     for (long i = 0; i < a->nRows; i++)
     {
         for (long j = 0; j < b->nColumns; j++)
@@ -163,6 +480,10 @@ int multiplyMatrix(const Matrix *a, const Matrix *b, Matrix *multiplied)
         }
     }
 
+#ifdef USE_CBLAS
+    compareBlock(check, multiplied, 0, 0, a->nRows, b->nColumns);
+#endif
+
     return OK;
 }
 
@@ -175,6 +496,16 @@ int multiplyMatrixAndSum(const Matrix *a, const Matrix *b, Matrix *multiplied)
         return NOK;
     }
 
+#ifdef USE_CBLAS
+    double *check = NULL;
+
+    if (blasMultiply(a, b, multiplied, 0, 0, 0, 0, 0, 0, a->nRows, a->nColumns, b->nColumns, 1.0, &check) == OK &&
+        check == NULL)
+    {
+        return OK;
+    }
+#endif
+
     for (long i = 0; i < a->nRows; i++)
     {
         for (long j = 0; j < b->nColumns; j++)
@@ -189,28 +520,40 @@ int multiplyMatrixAndSum(const Matrix *a, const Matrix *b, Matrix *multiplied)
         }
     }
 
+#ifdef USE_CBLAS
+    compareBlock(check, multiplied, 0, 0, a->nRows, b->nColumns);
+#endif
+
     return OK;
 }
 
-int multiplyMatrixAndSumBlock(const Matrix *a,
-                              const Matrix *b,
-                              Matrix *multiplied,
-                              int arow,
-                              int acol,
-                              int brow,
-                              int bcol,
-                              int crow,
-                              int ccol,
-                              int l,
-                              int m,
-                              int n)
+/**
+ * With threads every quadrant sub-product is a task. The two products
+ * that add to the same output quadrant are ordered by their
+ * dependency on it, the other quadrants run in parallel.
+ * Splitting doesn't change the order of the sums of each value, so the
+ * results are the same with any number of threads.
+ */
+static void multiplyBlockTasks(const Matrix *a,
+                               const Matrix *b,
+                               Matrix *multiplied,
+                               long arow,
+                               long acol,
+                               long brow,
+                               long bcol,
+                               long crow,
+                               long ccol,
+                               long l,
+                               long m,
+                               long n,
+                               int parallel)
 {
     double *aptr, *bptr, *cptr;
 
-    int lhalf[3], mhalf[3], nhalf[3]; // Quadrant sizes
+    long lhalf[3], mhalf[3], nhalf[3]; // Quadrant sizes
     int i, j, k;
 
-    if (m * n > CACHE_THRESHOLD)
+    if (m * n > CACHE_THRESHOLD || (parallel && l * m * n >= 8 * TASK_THRESHOLD && l > 1 && m > 1 && n > 1))
     {
         /* B doesn't fit in cache --- multiply blocks of A, B*/
 
@@ -232,21 +575,31 @@ int multiplyMatrixAndSumBlock(const Matrix *a,
             {
                 for (k = 0; k < 2; k++)
                 {
-                    multiplyMatrixAndSumBlock(a,
-                                              b,
-                                              multiplied,
-                                              arow + lhalf[i],
-                                              acol + mhalf[k],
-                                              brow + mhalf[k],
-                                              bcol + nhalf[j],
-                                              crow + lhalf[i],
-                                              ccol + nhalf[j],
-                                              lhalf[i + 1],
-                                              mhalf[k + 1],
-                                              nhalf[j + 1]);
+#ifdef _OPENMP
+#pragma omp task if (parallel && l * m * n > 8 * TASK_THRESHOLD) \
+    depend(inout : multiplied->data[(crow + lhalf[i]) * multiplied->nColumns + (ccol + nhalf[j])])
+#endif
+                    multiplyBlockTasks(a,
+                                       b,
+                                       multiplied,
+                                       arow + lhalf[i],
+                                       acol + mhalf[k],
+                                       brow + mhalf[k],
+                                       bcol + nhalf[j],
+                                       crow + lhalf[i],
+                                       ccol + nhalf[j],
+                                       lhalf[i + 1],
+                                       mhalf[k + 1],
+                                       nhalf[j + 1],
+                                       parallel);
                 }
             }
         }
+
+        // The sub-products may have tasks of their own
+#ifdef _OPENMP
+#pragma omp taskwait
+#endif
     }
     else
     {
@@ -266,17 +619,272 @@ int multiplyMatrixAndSumBlock(const Matrix *a,
             }
         }
     }
+}
+
+int multiplyMatrixAndSumBlock(const Matrix *a,
+                              const Matrix *b,
+                              Matrix *multiplied,
+                              long arow,
+                              long acol,
+                              long brow,
+                              long bcol,
+                              long crow,
+                              long ccol,
+                              long l,
+                              long m,
+                              long n)
+{
+    int parallel = 0;
+
+#ifdef USE_CBLAS
+    double *check = NULL;
+
+    if (blasMultiply(a, b, multiplied, arow, acol, brow, bcol, crow, ccol, l, m, n, 1.0, &check) == OK &&
+        check == NULL)
+    {
+        return OK;
+    }
+#endif
+
+#ifdef _OPENMP
+    parallel = omp_get_max_threads() > 1 && !omp_in_parallel() && l * m * n > TASK_THRESHOLD;
+#endif
+
+#ifdef _OPENMP
+#pragma omp parallel if (parallel)
+#pragma omp single
+#endif
+    multiplyBlockTasks(a, b, multiplied, arow, acol, brow, bcol, crow, ccol, l, m, n, parallel);
+
+#ifdef USE_CBLAS
+    compareBlock(check, multiplied, crow, ccol, l, n);
+#endif
+
+    return OK;
+}
+
+/**
+ * dst = x + sign * y, where x and y are dst sized blocks of other matrices
+ */
+static void addBlocks(Matrix *dst,
+                      const Matrix *x,
+                      long xrow,
+                      long xcol,
+                      const Matrix *y,
+                      long yrow,
+                      long ycol,
+                      double sign)
+{
+    for (long i = 0; i < dst->nRows; i++)
+    {
+        for (long j = 0; j < dst->nColumns; j++)
+        {
+            dst->data[i * dst->nColumns + j] =
+                x->data[(xrow + i) * x->nColumns + (xcol + j)] +
+                sign * y->data[(yrow + i) * y->nColumns + (ycol + j)];
+        }
+    }
+}
+
+/**
+ * c[crow.., ccol..] += sign * p
+ */
+static void addToBlock(Matrix *c, long crow, long ccol, const Matrix *p, double sign)
+{
+    for (long i = 0; i < p->nRows; i++)
+    {
+        for (long j = 0; j < p->nColumns; j++)
+        {
+            c->data[(crow + i) * c->nColumns + (ccol + j)] += sign * p->data[i * p->nColumns + j];
+        }
+    }
+}
+
+int multiplyMatrixAndSumStrassen(const Matrix *a,
+                                 const Matrix *b,
+                                 Matrix *multiplied,
+                                 long arow,
+                                 long acol,
+                                 long brow,
+                                 long bcol,
+                                 long crow,
+                                 long ccol,
+                                 long l,
+                                 long m,
+                                 long n,
+                                 long cutoff)
+{
+    // Flops of the classic algorithm, so the rates are comparable
+    double flops = 2.0 * l * m * n;
+    double bytes = sizeof(double) * ((double)l * m + (double)m * n + 2.0 * l * n);
+
+    perfStart(PERF_KERNEL_MULTIPLY);
+
+    if (cutoff <= 0 || l < cutoff || m < cutoff || n < cutoff || l % 2 != 0 || m % 2 != 0 || n % 2 != 0)
+    {
+        multiplyMatrixAndSumBlock(a, b, multiplied, arow, acol, brow, bcol, crow, ccol, l, m, n);
+        perfStop(PERF_KERNEL_MULTIPLY, flops, bytes);
+        return OK;
+    }
+
+    long lh = l / 2, mh = m / 2, nh = n / 2;
+
+    // Quadrant offsets
+    long a12col = acol + mh, a21row = arow + lh;
+    long b12col = bcol + nh, b21row = brow + mh;
+    long c12col = ccol + nh, c21row = crow + lh;
+
+    Matrix *s1 = createMatrixInCategory(lh, mh, MEMORY_TEMPORARIES);
+    Matrix *s2 = createMatrixInCategory(lh, mh, MEMORY_TEMPORARIES);
+    Matrix *s3 = createMatrixInCategory(lh, mh, MEMORY_TEMPORARIES);
+    Matrix *s4 = createMatrixInCategory(lh, mh, MEMORY_TEMPORARIES);
+    Matrix *t1 = createMatrixInCategory(mh, nh, MEMORY_TEMPORARIES);
+    Matrix *t2 = createMatrixInCategory(mh, nh, MEMORY_TEMPORARIES);
+    Matrix *t3 = createMatrixInCategory(mh, nh, MEMORY_TEMPORARIES);
+    Matrix *t4 = createMatrixInCategory(mh, nh, MEMORY_TEMPORARIES);
+    Matrix *p = createMatrixInCategory(lh, nh, MEMORY_TEMPORARIES);
+
+    // S1 = A21 + A22, S2 = S1 - A11, S3 = A11 - A21, S4 = A12 - S2
+    addBlocks(s1, a, a21row, acol, a, a21row, a12col, 1.0);
+    addBlocks(s2, s1, 0, 0, a, arow, acol, -1.0);
+    addBlocks(s3, a, arow, acol, a, a21row, acol, -1.0);
+    addBlocks(s4, a, arow, a12col, s2, 0, 0, -1.0);
+
+    // T1 = B12 - B11, T2 = B22 - T1, T3 = B22 - B12, T4 = T2 - B21
+    addBlocks(t1, b, brow, b12col, b, brow, bcol, -1.0);
+    addBlocks(t2, b, b21row, b12col, t1, 0, 0, -1.0);
+    addBlocks(t3, b, b21row, b12col, b, brow, b12col, -1.0);
+    addBlocks(t4, t2, 0, 0, b, b21row, bcol, -1.0);
+
+    // P1 = A11 * B11 -> C11, C12, C21, C22
+    fillMatrixWithZeros(p);
+    multiplyMatrixAndSumStrassen(a, b, p, arow, acol, brow, bcol, 0, 0, lh, mh, nh, cutoff);
+    addToBlock(multiplied, crow, ccol, p, 1.0);
+    addToBlock(multiplied, crow, c12col, p, 1.0);
+    addToBlock(multiplied, c21row, ccol, p, 1.0);
+    addToBlock(multiplied, c21row, c12col, p, 1.0);
+
+    // P2 = A12 * B21 -> C11
+    multiplyMatrixAndSumStrassen(a, b, multiplied, arow, a12col, b21row, bcol, crow, ccol, lh, mh, nh, cutoff);
+
+    // P3 = S4 * B22 -> C12
+    multiplyMatrixAndSumStrassen(s4, b, multiplied, 0, 0, b21row, b12col, crow, c12col, lh, mh, nh, cutoff);
+
+    // P4 = A22 * T4 -> -C21
+    fillMatrixWithZeros(p);
+    multiplyMatrixAndSumStrassen(a, t4, p, a21row, a12col, 0, 0, 0, 0, lh, mh, nh, cutoff);
+    addToBlock(multiplied, c21row, ccol, p, -1.0);
+
+    // P5 = S1 * T1 -> C12, C22
+    fillMatrixWithZeros(p);
+    multiplyMatrixAndSumStrassen(s1, t1, p, 0, 0, 0, 0, 0, 0, lh, mh, nh, cutoff);
+    addToBlock(multiplied, crow, c12col, p, 1.0);
+    addToBlock(multiplied, c21row, c12col, p, 1.0);
+
+    // P6 = S2 * T2 -> C12, C21, C22
+    fillMatrixWithZeros(p);
+    multiplyMatrixAndSumStrassen(s2, t2, p, 0, 0, 0, 0, 0, 0, lh, mh, nh, cutoff);
+    addToBlock(multiplied, crow, c12col, p, 1.0);
+    addToBlock(multiplied, c21row, ccol, p, 1.0);
+    addToBlock(multiplied, c21row, c12col, p, 1.0);
+
+    // P7 = S3 * T3 -> C21, C22
+    fillMatrixWithZeros(p);
+    multiplyMatrixAndSumStrassen(s3, t3, p, 0, 0, 0, 0, 0, 0, lh, mh, nh, cutoff);
+    addToBlock(multiplied, c21row, ccol, p, 1.0);
+    addToBlock(multiplied, c21row, c12col, p, 1.0);
+
+    destroyMatrix(s1);
+    destroyMatrix(s2);
+    destroyMatrix(s3);
+    destroyMatrix(s4);
+    destroyMatrix(t1);
+    destroyMatrix(t2);
+    destroyMatrix(t3);
+    destroyMatrix(t4);
+    destroyMatrix(p);
+
+    perfStop(PERF_KERNEL_MULTIPLY, flops, bytes);
 
     return OK;
 }
 
+long strassenTemporaryBytes(long l, long m, long n, long cutoff)
+{
+    // Same condition as multiplyMatrixAndSumStrassen
+    if (cutoff <= 0 || l < cutoff || m < cutoff || n < cutoff || l % 2 != 0 || m % 2 != 0 || n % 2 != 0)
+    {
+        return 0;
+    }
+
+    long lh = l / 2, mh = m / 2, nh = n / 2;
+
+    // S1..S4, T1..T4 and P stay allocated during the sub-products
+    return sizeof(double) * (4 * lh * mh + 4 * mh * nh + lh * nh) + strassenTemporaryBytes(lh, mh, nh, cutoff);
+}
+
+double strassenError(const Matrix *a, long cutoff)
+{
+    // Largest square block starting at (0, 0)
+    long n = a->nRows < a->nColumns ? a->nRows : a->nColumns;
+
+    Matrix *classic = createMatrixFilledWithZeros(n, n);
+    Matrix *strassen = createMatrixFilledWithZeros(n, n);
+
+    multiplyMatrixAndSumBlock(a, a, classic, 0, 0, 0, 0, 0, 0, n, n, n);
+    multiplyMatrixAndSumStrassen(a, a, strassen, 0, 0, 0, 0, 0, 0, n, n, n, cutoff);
+
+    double error = 0.0;
+    for (long i = 0; i < n * n; i++)
+    {
+        double v = fabs(classic->data[i] - strassen->data[i]);
+        if (v > error)
+        {
+            error = v;
+        }
+    }
+
+    destroyMatrix(classic);
+    destroyMatrix(strassen);
+
+    return error;
+}
+
 int divideMatrixByLong(Matrix *a, long number)
 {
+    double length = (double)a->nRows * a->nColumns;
+
+    perfStart(PERF_KERNEL_DIVIDE);
+
+#ifdef USE_CBLAS
+    double *check = NULL;
+
+    if (blasFits(a->nRows * a->nColumns, 1, 1))
+    {
+        // Multiplies by 1 / number: not always the same rounding
+        if (backend == BACKEND_CBLAS)
+        {
+            cblas_dscal((int)length, 1.0 / number, a->data, 1);
+            perfStop(PERF_KERNEL_DIVIDE, length, 2.0 * sizeof(double) * length);
+            return OK;
+        }
+
+        check = copyBlock(a, 0, 0, a->nRows, a->nColumns);
+        cblas_dscal((int)length, 1.0 / number, check, 1);
+    }
+#endif
+
     for (long i = 0; i < a->nRows * a->nColumns; i++)
     {
         a->data[i] /= number;
     }
 
+#ifdef USE_CBLAS
+    compareBlock(check, a, 0, 0, a->nRows, a->nColumns);
+#endif
+
+    perfStop(PERF_KERNEL_DIVIDE, length, 2.0 * sizeof(double) * length);
+
     return OK;
 }
 
@@ -5,6 +5,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef USE_CBLAS
+#include <cblas.h>
+#endif
 
 #include "util.h"
 
@@ -15,8 +24,30 @@ typedef struct matrix
     double *data;
 } Matrix;
 
+/**
+ * Backend of the multiplications, sums, scaling and max (-b).
+ * BACKEND_CBLAS routes them to cblas_dgemm / daxpy / dscal / idamax,
+ * BACKEND_CHECK runs both the built-in kernels and cblas, keeps the
+ * built-in result and records the largest difference.
+ * Only available when built with -DUSE_CBLAS (and a cblas library);
+ * matrices too large for the int sizes of cblas use the built-in kernels.
+ */
+void setMatrixBackend(int backend);
+
+/**
+ * Largest difference between the two backends (BACKEND_CHECK), relative
+ * to the largest value of the result it was found in
+ */
+double backendDifference();
+
 Matrix *createMatrix(long nRows, long nColumns);
 
+/**
+ * createMatrix with its data counted in the given category (MEMORY_*)
+ * instead of MEMORY_MATRICES
+ */
+Matrix *createMatrixInCategory(long nRows, long nColumns, int category);
+
 Matrix *createMatrixFilledWithZeros(long nRows, long nColumns);
 
 void destroyMatrix(Matrix *m);
@@ -34,16 +65,54 @@ int copySubMatrix(Matrix *a,
 
 double maxMij(const Matrix *m);
 
+/**
+ * Infinity norm: max over the rows of sum |m(i,j)|
+ */
+double maxRowSum(const Matrix *m);
+
+/**
+ * Adds |m(i,j)| to sums[j]. Used for the 1-norm (max column sum).
+ */
+int addColumnSums(const Matrix *m, double *sums);
+
+/**
+ * 1-norm: max over the columns of sum |m(i,j)|
+ */
+double maxColumnSum(const Matrix *m);
+
+/**
+ * Number of terms after which |M_k(i,j)| <= ||A||^k / k! is within the
+ * tolerance. Never less than 2: we always calculate M_2.
+ */
+long termsForTolerance(double norm, double tolerance);
+
 int fillMatrixWithRandom(Matrix *a);
 
 int fillMatrixWithZeros(Matrix *a);
 
+/**
+ * Keeps each entry of a with probability density, zeroes it otherwise
+ */
+int sparsifyMatrix(Matrix *a, double density);
+
 int fillArrayWithRandom(double *a, long n);
 
 int fillArrayWithZeros(double *a, long n);
 
 int sumMatrix(const Matrix *m, Matrix *s);
 
+/**
+ * s = s + factor * m
+ */
+int sumScaledMatrix(const Matrix *m, double factor, Matrix *s);
+
+/**
+ * Adds the term M_k to each S_t of exp(t A): S_t = S_t + t^k M_k.
+ * powers holds t^(k-1) and is updated to t^k.
+ * Returns max |t^k|, the scale of the largest term added.
+ */
+double sumTaylorTerm(const Matrix *m, Matrix **s, const double *times, double *powers, int nTimes);
+
 /**
  * Fills the matrix with the Identity Matrix starting in
  * startRow and startColumn
@@ -74,20 +143,54 @@ int multiplyMatrix(const Matrix *a, const Matrix *b, Matrix *multiplied);
 int multiplyMatrixAndSum(const Matrix *a, const Matrix *b, Matrix *multiplied);
 
 /**
- * Multiplies two matrices using the method presented in PPC (p.276)
+ * Multiplies two matrices using the method presented in PPC (p.276).
+ * Runs the quadrant sub-products as OpenMP tasks when there is more
+ * than one thread (see -j).
  */
 int multiplyMatrixAndSumBlock(const Matrix *a,
                               const Matrix *b,
                               Matrix *multiplied,
-                              int arow,
-                              int acol,
-                              int brow,
-                              int bcol,
-                              int crow,
-                              int ccol,
-                              int l,
-                              int m,
-                              int n);
+                              long arow,
+                              long acol,
+                              long brow,
+                              long bcol,
+                              long crow,
+                              long ccol,
+                              long l,
+                              long m,
+                              long n);
+
+/**
+ * Multiplies two matrices using the Strassen-Winograd recursion
+ * (7 sub-multiplications instead of 8) while the blocks are at least
+ * cutoff x cutoff and have even dimensions. Smaller blocks use
+ * multiplyMatrixAndSumBlock. cutoff <= 0 disables the recursion.
+ */
+int multiplyMatrixAndSumStrassen(const Matrix *a,
+                                 const Matrix *b,
+                                 Matrix *multiplied,
+                                 long arow,
+                                 long acol,
+                                 long brow,
+                                 long bcol,
+                                 long crow,
+                                 long ccol,
+                                 long l,
+                                 long m,
+                                 long n,
+                                 long cutoff);
+
+/**
+ * Bytes of the temporaries that multiplyMatrixAndSumStrassen holds at
+ * its deepest recursion level for an l x m by m x n product
+ */
+long strassenTemporaryBytes(long l, long m, long n, long cutoff);
+
+/**
+ * Returns the max difference between the classic and the
+ * Strassen-Winograd products of the leading square block of a by itself
+ */
+double strassenError(const Matrix *a, long cutoff);
 
 int divideMatrixByLong(Matrix *a, long number);
 
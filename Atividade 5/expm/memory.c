@@ -0,0 +1,155 @@
+#include "memory.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * In front of every tracked block. The union keeps the block aligned
+ * like malloc's.
+ */
+typedef union block_header
+{
+    struct
+    {
+        size_t size;
+        int category;
+    } info;
+
+    max_align_t align;
+} BlockHeader;
+
+/**
+ * Bytes held and high-water marks of each category, the last ones for
+ * all of them together
+ */
+static long current[MEMORY_N_CATEGORIES + 1];
+static long peak[MEMORY_N_CATEGORIES + 1];
+
+/**
+ * The counters change from several threads: the OpenMP tasks (-j)
+ * allocate Strassen temporaries and the background writer (-W) frees
+ * its snapshots while the main thread allocates
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+void trackMemory(int category, long bytes)
+{
+    pthread_mutex_lock(&lock);
+
+    current[category] += bytes;
+    current[MEMORY_N_CATEGORIES] += bytes;
+
+    if (current[category] > peak[category])
+    {
+        peak[category] = current[category];
+    }
+
+    if (current[MEMORY_N_CATEGORIES] > peak[MEMORY_N_CATEGORIES])
+    {
+        peak[MEMORY_N_CATEGORIES] = current[MEMORY_N_CATEGORIES];
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+void *allocateTracked(size_t size, int category)
+{
+    BlockHeader *header = (BlockHeader *)malloc(sizeof(BlockHeader) + size);
+
+    if (header == NULL)
+    {
+        return NULL;
+    }
+
+    header->info.size = size;
+    header->info.category = category;
+
+    trackMemory(category, (long)size);
+
+    return header + 1;
+}
+
+void freeTracked(void *p)
+{
+    if (p == NULL)
+    {
+        return;
+    }
+
+    BlockHeader *header = (BlockHeader *)p - 1;
+
+    trackMemory(header->info.category, -(long)header->info.size);
+
+    free(header);
+}
+
+const char *memoryCategoryName(int category)
+{
+    static const char *names[MEMORY_N_CATEGORIES + 1] = {
+        "matrices", "temporaries", "buffers", "zeroes", "windows", "total"
+    };
+
+    return names[category];
+}
+
+void memoryReport(int myrank, int npes, MPI_Comm comm)
+{
+    long *peaks = NULL;
+    long *held = NULL;
+
+    if (myrank == 0)
+    {
+        peaks = (long *)malloc(sizeof(long) * (MEMORY_N_CATEGORIES + 1) * npes);
+        held = (long *)malloc(sizeof(long) * npes);
+    }
+
+    // A consistent copy of the counters
+    long myPeak[MEMORY_N_CATEGORIES + 1];
+    long myHeld;
+
+    pthread_mutex_lock(&lock);
+    memcpy(myPeak, peak, sizeof(myPeak));
+    myHeld = current[MEMORY_N_CATEGORIES];
+    pthread_mutex_unlock(&lock);
+
+    MPI_Gather(myPeak, MEMORY_N_CATEGORIES + 1, MPI_LONG, peaks, MEMORY_N_CATEGORIES + 1, MPI_LONG, 0, comm);
+    MPI_Gather(&myHeld, 1, MPI_LONG, held, 1, MPI_LONG, 0, comm);
+
+    if (myrank != 0)
+    {
+        return;
+    }
+
+    printf("Memory high-water marks (MB): largest process, sum of the processes\n");
+
+    for (int c = 0; c <= MEMORY_N_CATEGORIES; c++)
+    {
+        long max = 0, sum = 0;
+        int maxRank = 0;
+
+        for (int p = 0; p < npes; p++)
+        {
+            long value = peaks[p * (MEMORY_N_CATEGORIES + 1) + c];
+
+            sum += value;
+            if (value > max)
+            {
+                max = value;
+                maxRank = p;
+            }
+        }
+
+        printf("  %-12s %12.3f (#%d) %12.3f\n", memoryCategoryName(c), max / 1e6, maxRank, sum / 1e6);
+    }
+
+    for (int p = 0; p < npes; p++)
+    {
+        if (held[p] != 0)
+        {
+            printf("[WARNING] Process #%d still holds %ld bytes of matrices and buffers\n", p, held[p]);
+        }
+    }
+
+    free(peaks);
+    free(held);
+}
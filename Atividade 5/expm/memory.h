@@ -0,0 +1,53 @@
+#ifndef __MEMORY_H__
+#define __MEMORY_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <mpi.h>
+
+#include "util.h"
+
+/**
+ * Accounting of the memory of the matrices and their buffers.
+ *
+ * The blocks come from allocateTracked, which keeps their size and
+ * category in a header in front of them, so they can change hands (the
+ * M_k data is swapped with multiplied and with the receive buffers) and
+ * still be freed from the right category. Each process keeps the bytes
+ * it holds and the largest amount it has held, per category and in
+ * total. Memory allocated by MPI (the windows of the shm and rma
+ * transports) is added with trackMemory. The out-of-core matrices (-O)
+ * are file mappings and aren't counted.
+ */
+
+/**
+ * size bytes of the category (MEMORY_*). Like malloc, the block is
+ * aligned for any type.
+ */
+void *allocateTracked(size_t size, int category);
+
+/**
+ * Frees a block from allocateTracked (NULL does nothing)
+ */
+void freeTracked(void *p);
+
+/**
+ * Adds bytes (negative when it's freed) held outside allocateTracked
+ */
+void trackMemory(int category, long bytes);
+
+/**
+ * Name of a category
+ */
+const char *memoryCategoryName(int category);
+
+/**
+ * Prints, on process #0, the largest high-water mark of each category
+ * (and the process that reached it) and their sum over the processes,
+ * and warns about the processes that still hold tracked memory.
+ * Must be called by every process of comm.
+ */
+void memoryReport(int myrank, int npes, MPI_Comm comm);
+
+#endif
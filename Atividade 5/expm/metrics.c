@@ -0,0 +1,243 @@
+#include "metrics.h"
+
+/**
+ * Terms left until the tolerance, NAN if the rate isn't known yet
+ */
+static double remainingTerms(const Metrics *m, long nTerms)
+{
+    if (!m->running)
+    {
+        return 0;
+    }
+
+    if (nTerms > 0)
+    {
+        return nTerms > m->k ? nTerms - m->k : 0;
+    }
+
+    if (isnan(m->max) || isnan(m->previousMax) || m->previousMax <= 0.0)
+    {
+        return NAN;
+    }
+
+    if (m->max <= m->tolerance)
+    {
+        return 0;
+    }
+
+    double ratio = m->max / m->previousMax;
+
+    if (ratio <= 0.0 || ratio >= 1.0)
+    {
+        // Still growing
+        return NAN;
+    }
+
+    return ceil(log(m->tolerance / m->max) / log(ratio));
+}
+
+/**
+ * Value in the exposition format: NaN and +Inf / -Inf are spelled out
+ */
+static void writeValue(FILE *fp, double value)
+{
+    if (isnan(value))
+    {
+        fprintf(fp, "NaN\n");
+    }
+    else if (isinf(value))
+    {
+        fprintf(fp, "%cInf\n", value > 0 ? '+' : '-');
+    }
+    else
+    {
+        fprintf(fp, "%.17g\n", value);
+    }
+}
+
+static void writeMetric(FILE *fp, const char *name, const char *type, const char *help, double value)
+{
+    fprintf(fp, "# HELP %s %s\n# TYPE %s %s\n%s ", name, help, name, type, name);
+    writeValue(fp, value);
+}
+
+/**
+ * Writes every metric to a temporary file and renames it over the file
+ */
+static int writeMetrics(const Metrics *m, long nTerms)
+{
+    char tmpPath[METRICS_PATH_LENGTH];
+
+    snprintf(tmpPath, sizeof(tmpPath), "%s.XXXXXX", m->path);
+
+    int fd = mkstemp(tmpPath);
+    if (fd == -1)
+    {
+        return NOK;
+    }
+
+    // The exporter may run as another user
+    fchmod(fd, 0644);
+
+    FILE *fp = fdopen(fd, "w");
+    double remaining = remainingTerms(m, nTerms);
+
+    writeMetric(fp, "expm_running", "gauge", "1 while the Taylor terms are being computed", m->running);
+    writeMetric(fp, "expm_matrix_size", "gauge", "Dimension n of A", m->n);
+    writeMetric(fp, "expm_processes", "gauge", "Number of processes", m->npes);
+    writeMetric(fp, "expm_tolerance", "gauge", "Tolerance of the stop condition", m->tolerance);
+    writeMetric(fp, "expm_term", "gauge", "Last Taylor term computed (k)", m->k);
+    writeMetric(fp, "expm_max_term", "gauge", "Largest |t^k M_k(i,j)| of the last term", m->max);
+    writeMetric(fp, "expm_seconds_per_term", "gauge", "Duration of the last term", m->secondsPerTerm);
+    writeMetric(fp,
+                "expm_gflops",
+                "gauge",
+                "Multiply rate of the last term (2 n^3 flops per term)",
+                m->secondsPerTerm > 0.0 ? 2.0 * m->n * m->n * m->n / m->secondsPerTerm / 1e9 : 0.0);
+
+    if (m->ring)
+    {
+        writeMetric(fp, "expm_ring_bytes_total", "counter", "Bytes of M_k sent between the processes", m->bytes);
+    }
+
+    writeMetric(fp, "expm_remaining_terms", "gauge", "Terms left, from the convergence rate", remaining);
+    writeMetric(fp, "expm_eta_seconds", "gauge", "Estimated time left", remaining * m->secondsPerTerm);
+    writeMetric(fp, "expm_elapsed_seconds", "gauge", "Time since the terms started", MPI_Wtime() - m->start);
+    writeMetric(fp, "expm_last_update_timestamp_seconds", "gauge", "Time of this update", (double)time(NULL));
+
+    if (m->knownProcesses)
+    {
+        fprintf(fp,
+                "# HELP expm_process_multiply_seconds Multiply time of each process in the last term\n"
+                "# TYPE expm_process_multiply_seconds gauge\n");
+
+        for (int p = 0; p < m->npes; p++)
+        {
+            fprintf(fp, "expm_process_multiply_seconds{process=\"%d\"} ", p);
+            writeValue(fp, m->processSeconds[p]);
+        }
+    }
+
+    if (fclose(fp) != 0 || rename(tmpPath, m->path) != 0)
+    {
+        unlink(tmpPath);
+        return NOK;
+    }
+
+    return OK;
+}
+
+Metrics *createMetrics(const char *path, long n, int npes, double tolerance, int ring)
+{
+    Metrics *m = (Metrics *)malloc(sizeof(Metrics));
+
+    m->path = (char *)malloc(strlen(path) + 1);
+    strcpy(m->path, path);
+
+    m->n = n;
+    m->npes = npes;
+    m->tolerance = tolerance;
+    m->start = m->termStart = MPI_Wtime();
+    m->k = 1;
+    m->max = m->previousMax = NAN;
+    m->secondsPerTerm = 0.0;
+    m->bytes = 0.0;
+    m->ring = ring;
+    m->processSeconds = (double *)malloc(sizeof(double) * npes);
+    m->knownProcesses = 0;
+    m->running = 1;
+
+    if (strlen(path) + 8 > METRICS_PATH_LENGTH || writeMetrics(m, 0) != OK)
+    {
+        printf("[WARNING] Could not write the metrics to %s\n", path);
+
+        free(m->processSeconds);
+        free(m->path);
+        free(m);
+        return NULL;
+    }
+
+    return m;
+}
+
+void destroyMetrics(Metrics *m)
+{
+    if (m == NULL)
+    {
+        return;
+    }
+
+    m->running = 0;
+    writeMetrics(m, 0);
+
+    free(m->processSeconds);
+    free(m->path);
+    free(m);
+}
+
+int updateMetrics(Metrics *m, long k, double max, double bytes, const double *processSeconds, long nTerms)
+{
+    if (m == NULL)
+    {
+        return OK;
+    }
+
+    double now = MPI_Wtime();
+
+    m->secondsPerTerm = now - m->termStart;
+    m->termStart = now;
+
+    m->k = k;
+    m->previousMax = m->max;
+    m->max = max;
+    m->bytes = bytes;
+
+    m->knownProcesses = processSeconds != NULL;
+    if (processSeconds != NULL)
+    {
+        memcpy(m->processSeconds, processSeconds, sizeof(double) * m->npes);
+    }
+
+    return writeMetrics(m, nTerms);
+}
+
+int reportMetrics(Metrics *m,
+                  long k,
+                  double max,
+                  double bytes,
+                  double multiplySeconds,
+                  long nTerms,
+                  int myrank,
+                  int npes,
+                  MPI_Comm comm)
+{
+    double mine[2] = {multiplySeconds, bytes};
+    double *all = NULL;
+    int res = OK;
+
+    if (myrank == 0)
+    {
+        all = (double *)malloc(sizeof(double) * 2 * npes);
+    }
+
+    MPI_Gather(mine, 2, MPI_DOUBLE, all, 2, MPI_DOUBLE, 0, comm);
+
+    if (myrank == 0)
+    {
+        double *seconds = (double *)malloc(sizeof(double) * npes);
+        double total = 0.0;
+
+        for (int p = 0; p < npes; p++)
+        {
+            seconds[p] = all[2 * p];
+            total += all[2 * p + 1];
+        }
+
+        res = updateMetrics(m, k, max, total, seconds, nTerms);
+
+        free(seconds);
+        free(all);
+    }
+
+    return res;
+}
@@ -0,0 +1,94 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <mpi.h>
+
+#include "util.h"
+
+/**
+ * Live metrics of a run (-M), rewritten after every term in the
+ * Prometheus text format, so the textfile collector of the node exporter
+ * can scrape them (the file name must end in .prom). Each update goes to
+ * a temporary file that is renamed over the previous one: a scrape never
+ * sees half a file.
+ *
+ * The ETA comes from the a-priori number of terms (-a) or, without it,
+ * from the ratio between the last two maxima: the terms left until the
+ * maximum is within the tolerance, at the time of the last term.
+ * Only process #0 writes the file.
+ */
+typedef struct metrics
+{
+    char *path;
+
+    long n;
+    int npes;
+    double tolerance;
+
+    double start;
+    double termStart;
+
+    long k;
+    double max;
+    double previousMax;
+    double secondsPerTerm;
+
+    /**
+     * Bytes sent by the ring, only exported with the ring transport
+     */
+    double bytes;
+    int ring;
+
+    /**
+     * Multiply time of each process in the last term (npes values, or
+     * none if they aren't known)
+     */
+    double *processSeconds;
+    int knownProcesses;
+
+    int running;
+} Metrics;
+
+/**
+ * Writes the first version of the file. ring is set if the M_k blocks go
+ * through the ring transport. Returns NULL if the file can't be written.
+ */
+Metrics *createMetrics(const char *path, long n, int npes, double tolerance, int ring);
+
+/**
+ * Writes the final version of the file (the run is no longer running)
+ */
+void destroyMetrics(Metrics *m);
+
+/**
+ * Records the end of term k. max is the largest scaled |M_k(i,j)| (NAN
+ * if it wasn't computed), bytes the total sent between the processes
+ * so far, processSeconds the multiply time of each process in this term
+ * (NULL if not known) and nTerms the a-priori number of terms (0 if
+ * not used).
+ */
+int updateMetrics(Metrics *m, long k, double max, double bytes, const double *processSeconds, long nTerms);
+
+/**
+ * updateMetrics from every process of comm: gathers the multiply time
+ * of the term and the bytes sent by each process on process #0, which
+ * writes the file. m is only used on process #0.
+ */
+int reportMetrics(Metrics *m,
+                  long k,
+                  double max,
+                  double bytes,
+                  double multiplySeconds,
+                  long nTerms,
+                  int myrank,
+                  int npes,
+                  MPI_Comm comm);
+
+#endif
@@ -1,22 +1,551 @@
 #include "multi_process.h"
 
-int multiProcess(
-    ParsedParams *params,
-    const Matrix *globalA,
-    Matrix *globalS,
-    int myrank,
-    int npes)
+/**
+ * One Taylor term of the task graph (-G)
+ */
+typedef struct term_tasks
 {
     /**
-     * Temp array for faster buffer unload
+     * t^k for each t and the largest |t^k|
+     */
+    double *powers;
+    double scale;
+
+    /**
+     * Largest |M_k(i,j)| of our tiles, then of every process
+     */
+    double max;
+
+    /**
+     * Tasks of each column tile and the convergence check.
+     * multiplies and receives have one task per tile and block
+     * (tile * npes + step / owner). M_1 = A only has sends and
+     * receives.
+     */
+    Task **multiplies;
+    Task **sends;
+    Task **receives;
+    Task **sums;
+    Task *check;
+} TermTasks;
+
+/**
+ * The Taylor terms as a task graph (-G).
+ *
+ * Column tile J of M_k only needs column tile J of M_k-1, so every
+ * column tile moves on to the next term as soon as its blocks arrive:
+ * the tiles of M_k+1 are multiplied while the other tiles of M_k are
+ * still in flight, and the convergence check of M_k (a non-blocking
+ * reduction of the partial maxima) overlaps the next term. Each block
+ * of a tile is multiplied as soon as it arrives, in the order of the
+ * ring so the sums are the same. M_k+1 is
+ * computed before the check of M_k says it is needed and is dropped if
+ * it isn't. The terms are added to S in order, after the check of the
+ * previous one.
+ *
+ * Instead of the ring, every process sends its tiles to all the others
+ * and keeps the full M_k and M_k-1, in m[k % 2].
+ */
+typedef struct term_graph
+{
+    const ParsedParams *params;
+    Transport *t;
+    const Matrix *a;
+    Matrix **s;
+    Matrix *m[2];
+
+    long tileWidth;
+    long nTiles;
+
+    /**
+     * Column tile of one block, for each tile
+     */
+    MPI_Datatype *tileTypes;
+
+    /**
+     * Terms from the a-priori bound (-a) and last term needed, LONG_MAX
+     * until a check stops
      */
-    double *tmp;
+    long nTerms;
+    long lastTerm;
+
+    TermTasks **terms;
+    long termCapacity;
 
     /**
-     * Local receive buffer
+     * Live metrics (-M), only on process #0
      */
-    double *recvBuffer;
+    Metrics *metrics;
+} TermGraph;
+
+static long tileColumns(const TermGraph *tg, long tile)
+{
+    long columns = tg->a->nColumns - tile * tg->tileWidth;
+
+    return columns < tg->tileWidth ? columns : tg->tileWidth;
+}
+
+/**
+ * Tag of the messages with column tile of M_k
+ */
+static int tileTag(long k, long tile)
+{
+    return MESSAGE_TAG_M_TILE + 2 * tile + k % 2;
+}
+
+/**
+ * Our rows of column tile of M_k += A(:, rows of owner) * M_k-1(rows
+ * of owner, tile), for the step-th block in ring order. The first step
+ * clears the tile and the last one divides it by k.
+ */
+static void multiplyTileTask(TaskGraph *g, Task *task)
+{
+    (void)g;
+
+    TermGraph *tg = (TermGraph *)task->context;
+    Transport *t = tg->t;
+    Matrix *m = tg->m[task->k % 2];
+    long tile = task->index / t->npes;
+    long step = task->index % t->npes;
+    long owner = (t->myrank + step) % t->npes;
+    long first = tile * tg->tileWidth;
+    long columns = tileColumns(tg, tile);
+    long crow = t->myrank * t->nRows;
+    double max = 0.0;
+
+    double ti = MPI_Wtime();
+
+    if (step == 0)
+    {
+        for (long i = crow; i < crow + t->nRows; i++)
+        {
+            fillArrayWithZeros(m->data + i * m->nColumns + first, columns);
+        }
+    }
+
+    multiplyMatrixAndSumStrassen(tg->a,
+                                 tg->m[(task->k - 1) % 2],
+                                 m,
+                                 0,
+                                 t->rowOffsets[owner],
+                                 t->rowOffsets[owner],
+                                 first,
+                                 crow,
+                                 first,
+                                 t->nRows,
+                                 t->rowCounts[owner],
+                                 columns,
+                                 t->strassenCutoff);
+
+    if (step == t->npes - 1)
+    {
+        for (long i = crow; i < crow + t->nRows; i++)
+        {
+            double *row = m->data + i * m->nColumns + first;
+
+            for (long j = 0; j < columns; j++)
+            {
+                row[j] /= task->k;
+                max = fabs(row[j]) > max ? fabs(row[j]) : max;
+            }
+        }
+
+        TermTasks *term = tg->terms[task->k];
+        term->max = max > term->max ? max : term->max;
+    }
+
+    t->multiplyTime += MPI_Wtime() - ti;
+}
+
+/**
+ * Sends our rows of a column tile of M_k to every other process
+ */
+static void sendTileTask(TaskGraph *g, Task *task)
+{
+    (void)g;
+
+    TermGraph *tg = (TermGraph *)task->context;
+    Transport *t = tg->t;
+    Matrix *m = tg->m[task->k % 2];
+    double *tile = m->data + t->myrank * t->nRows * m->nColumns + task->index * tg->tileWidth;
+
+    for (int p = 0; p < t->npes; p++)
+    {
+        if (p != t->myrank)
+        {
+            MPI_Isend(tile,
+                      1,
+                      tg->tileTypes[task->index],
+                      p,
+                      tileTag(task->k, task->index),
+                      t->comm,
+                      &task->requests[task->nRequests++]);
+        }
+    }
+
+    t->sentBytes += sizeof(double) * (t->npes - 1) * t->nRows * tileColumns(tg, task->index);
+}
+
+/**
+ * Receives the rows of one of the other processes of a column tile of
+ * M_k
+ */
+static void receiveTileTask(TaskGraph *g, Task *task)
+{
+    (void)g;
+
+    TermGraph *tg = (TermGraph *)task->context;
+    Transport *t = tg->t;
+    Matrix *m = tg->m[task->k % 2];
+    long tile = task->index / t->npes;
+    int owner = task->index % t->npes;
+
+    MPI_Irecv(m->data + t->rowOffsets[owner] * m->nColumns + tile * tg->tileWidth,
+              1,
+              tg->tileTypes[tile],
+              owner,
+              tileTag(task->k, tile),
+              t->comm,
+              &task->requests[task->nRequests++]);
+}
+
+/**
+ * S_t(:, tile) += t^k M_k(our rows, tile), if M_k is needed
+ */
+static void sumTileTask(TaskGraph *g, Task *task)
+{
+    (void)g;
+
+    TermGraph *tg = (TermGraph *)task->context;
+    TermTasks *term = tg->terms[task->k];
+    Matrix *m = tg->m[task->k % 2];
+    long nRows = tg->a->nRows;
+    long first = task->index * tg->tileWidth;
+    long columns = tileColumns(tg, task->index);
+    long crow = tg->t->myrank * nRows;
+
+    if (task->k > tg->lastTerm)
+    {
+        return;
+    }
+
+    for (int i = 0; i < tg->params->nTimes; i++)
+    {
+        for (long r = 0; r < nRows; r++)
+        {
+            double *srow = tg->s[i]->data + r * tg->s[i]->nColumns + first;
+            const double *mrow = m->data + (crow + r) * m->nColumns + first;
+
+            for (long j = 0; j < columns; j++)
+            {
+                srow[j] += term->powers[i] * mrow[j];
+            }
+        }
+    }
+}
+
+/**
+ * Starts the reduction of the largest scaled M_k(i,j), when the stop
+ * condition needs it
+ */
+static void checkTermTask(TaskGraph *g, Task *task)
+{
+    (void)g;
+
+    TermGraph *tg = (TermGraph *)task->context;
+    TermTasks *term = tg->terms[task->k];
+    const ParsedParams *params = tg->params;
+
+    if (task->k > tg->lastTerm ||
+        (params->aPriori && (task->k < tg->nTerms || !params->finalCheck)))
+    {
+        return;
+    }
+
+    term->max *= term->scale;
+
+    MPI_Iallreduce(MPI_IN_PLACE,
+                   &term->max,
+                   1,
+                   MPI_DOUBLE,
+                   MPI_MAX,
+                   tg->t->comm,
+                   &task->requests[task->nRequests++]);
+}
+
+static void addTerm(TaskGraph *g, TermGraph *tg, long k);
+
+/**
+ * Stop or continue? Every process takes the same decision, so they all
+ * build the same terms.
+ */
+static void checkTermDone(TaskGraph *g, Task *task)
+{
+    TermGraph *tg = (TermGraph *)task->context;
+    TermTasks *term = tg->terms[task->k];
+    const ParsedParams *params = tg->params;
+    int stop;
+
+    if (task->k > tg->lastTerm)
+    {
+        return;
+    }
+
+    // The max is known if the reduction ran. Every process sends the
+    // same number of bytes.
+    updateMetrics(tg->metrics,
+                  task->k,
+                  task->nRequests > 0 ? term->max : NAN,
+                  tg->t->sentBytes * tg->t->npes,
+                  NULL,
+                  tg->nTerms);
+
+    if (params->aPriori && task->k < tg->nTerms)
+    {
+        stop = 0;
+    }
+    else if (params->aPriori && !params->finalCheck)
+    {
+        stop = 1;
+    }
+    else
+    {
+        stop = term->max <= params->tolerance;
+    }
+
+    if (stop)
+    {
+        tg->lastTerm = task->k;
+    }
+    else
+    {
+        // M_k+1 is already on its way
+        addTerm(g, tg, task->k + 2);
+    }
+}
+
+static TermTasks *createTermTasks(const TermGraph *tg)
+{
+    TermTasks *term = (TermTasks *)malloc(sizeof(TermTasks));
+
+    term->powers = (double *)malloc(sizeof(double) * tg->params->nTimes);
+    term->scale = 0.0;
+    term->max = 0.0;
+    term->multiplies = (Task **)calloc(tg->nTiles * tg->t->npes, sizeof(Task *));
+    term->sends = (Task **)calloc(tg->nTiles, sizeof(Task *));
+    term->receives = (Task **)calloc(tg->nTiles * tg->t->npes, sizeof(Task *));
+    term->sums = (Task **)calloc(tg->nTiles, sizeof(Task *));
+    term->check = NULL;
+
+    return term;
+}
+
+/**
+ * Adds the tasks of M_k (k >= 2)
+ */
+static void addTerm(TaskGraph *g, TermGraph *tg, long k)
+{
+    if (k >= tg->termCapacity)
+    {
+        tg->terms = (TermTasks **)realloc(tg->terms, sizeof(TermTasks *) * 2 * k);
+        memset(tg->terms + tg->termCapacity, 0, sizeof(TermTasks *) * (2 * k - tg->termCapacity));
+        tg->termCapacity = 2 * k;
+    }
+
+    TermTasks *term = createTermTasks(tg);
+    TermTasks *previous = tg->terms[k - 1];
 
+    // The tiles of M_k-2 are overwritten by M_k
+    TermTasks *older = k > 2 ? tg->terms[k - 2] : NULL;
+
+    int npes = tg->t->npes;
+    int myrank = tg->t->myrank;
+
+    tg->terms[k] = term;
+
+    for (int i = 0; i < tg->params->nTimes; i++)
+    {
+        term->powers[i] = previous->powers[i] * tg->params->times[i];
+
+        if (fabs(term->powers[i]) > term->scale)
+        {
+            term->scale = fabs(term->powers[i]);
+        }
+    }
+
+    addTask(g, &term->check, checkTermTask, checkTermDone, tg, k, 0, 1);
+    addDependency(previous->check, term->check);
+
+    for (long tile = 0; tile < tg->nTiles; tile++)
+    {
+        Task **multiplies = term->multiplies + tile * npes;
+        Task **previousMultiplies = previous->multiplies + tile * npes;
+
+        for (int step = 0; step < npes; step++)
+        {
+            int owner = (myrank + step) % npes;
+
+            addTask(g, &multiplies[step], multiplyTileTask, NULL, tg, k, tile * npes + step, 0);
+
+            if (step == 0)
+            {
+                // Our rows of M_k-1, and M_k-2 no longer needed
+                addDependency(previousMultiplies[npes - 1], multiplies[step]);
+                if (older != NULL)
+                {
+                    addDependency(older->sends[tile], multiplies[step]);
+                    addDependency(older->sums[tile], multiplies[step]);
+                }
+            }
+            else
+            {
+                addDependency(multiplies[step - 1], multiplies[step]);
+                addDependency(previous->receives[tile * npes + owner], multiplies[step]);
+
+                // Its rows of M_k-2 were read by the multiply of M_k-1
+                addTask(g, &term->receives[tile * npes + owner], receiveTileTask, NULL, tg, k, tile * npes + owner, 1);
+                addDependency(previousMultiplies[step], term->receives[tile * npes + owner]);
+            }
+        }
+
+        addTask(g, &term->sends[tile], sendTileTask, NULL, tg, k, tile, npes - 1);
+        addDependency(multiplies[npes - 1], term->sends[tile]);
+
+        addTask(g, &term->sums[tile], sumTileTask, NULL, tg, k, tile, 0);
+        addDependency(multiplies[npes - 1], term->sums[tile]);
+        addDependency(previous->check, term->sums[tile]);
+
+        addDependency(multiplies[npes - 1], term->check);
+    }
+
+    for (long i = 0; i < tg->nTiles * npes; i++)
+    {
+        if (term->receives[i] != NULL)
+        {
+            submitTask(g, term->receives[i]);
+        }
+        submitTask(g, term->multiplies[i]);
+    }
+
+    for (long tile = 0; tile < tg->nTiles; tile++)
+    {
+        submitTask(g, term->sends[tile]);
+        submitTask(g, term->sums[tile]);
+    }
+
+    submitTask(g, term->check);
+}
+
+/**
+ * Adds the terms from M_2 to S, which holds I + t A, using the task
+ * graph. powers holds t. Returns the number of terms.
+ */
+static long taskGraphTerms(const ParsedParams *params,
+                           Transport *t,
+                           const Matrix *a,
+                           Matrix **s,
+                           const double *powers,
+                           long nTerms,
+                           Metrics *metrics)
+{
+    TermGraph tg;
+    TaskGraph *g = createTaskGraph();
+    long n = a->nColumns;
+
+    tg.params = params;
+    tg.t = t;
+    tg.a = a;
+    tg.s = s;
+    tg.m[0] = createMatrix(n, n);
+    tg.m[1] = createMatrix(n, n);
+    tg.tileWidth = TASK_GRAPH_TILE < n ? TASK_GRAPH_TILE : n;
+    tg.nTiles = (n + tg.tileWidth - 1) / tg.tileWidth;
+    tg.nTerms = nTerms;
+    tg.lastTerm = LONG_MAX;
+    tg.termCapacity = 16;
+    tg.terms = (TermTasks **)calloc(tg.termCapacity, sizeof(TermTasks *));
+    tg.metrics = metrics;
+
+    tg.tileTypes = (MPI_Datatype *)malloc(sizeof(MPI_Datatype) * tg.nTiles);
+    for (long tile = 0; tile < tg.nTiles; tile++)
+    {
+        MPI_Type_vector(t->nRows, tileColumns(&tg, tile), n, MPI_DOUBLE, &tg.tileTypes[tile]);
+        MPI_Type_commit(&tg.tileTypes[tile]);
+    }
+
+    // M_1 = A: our rows go to everyone
+    memcpy(tg.m[1]->data + t->myrank * t->nRows * n, a->data, sizeof(double) * t->nRows * n);
+
+    TermTasks *first = createTermTasks(&tg);
+    memcpy(first->powers, powers, sizeof(double) * params->nTimes);
+    tg.terms[1] = first;
+
+    for (long tile = 0; tile < tg.nTiles; tile++)
+    {
+        for (int owner = 0; owner < t->npes; owner++)
+        {
+            if (owner != t->myrank)
+            {
+                addTask(g,
+                        &first->receives[tile * t->npes + owner],
+                        receiveTileTask,
+                        NULL,
+                        &tg,
+                        1,
+                        tile * t->npes + owner,
+                        1);
+                submitTask(g, first->receives[tile * t->npes + owner]);
+            }
+        }
+
+        addTask(g, &first->sends[tile], sendTileTask, NULL, &tg, 1, tile, t->npes - 1);
+        submitTask(g, first->sends[tile]);
+    }
+
+    // M_2 is always needed, M_3 may be. The others are added when the
+    // check of the term before the previous one lets us continue.
+    addTerm(g, &tg, 2);
+    addTerm(g, &tg, 3);
+
+    runTaskGraph(g);
+
+    for (long k = 1; k < tg.termCapacity; k++)
+    {
+        if (tg.terms[k] == NULL)
+        {
+            continue;
+        }
+
+        free(tg.terms[k]->powers);
+        free(tg.terms[k]->multiplies);
+        free(tg.terms[k]->sends);
+        free(tg.terms[k]->receives);
+        free(tg.terms[k]->sums);
+        free(tg.terms[k]);
+    }
+
+    for (long tile = 0; tile < tg.nTiles; tile++)
+    {
+        MPI_Type_free(&tg.tileTypes[tile]);
+    }
+
+    free(tg.tileTypes);
+    free(tg.terms);
+    destroyMatrix(tg.m[0]);
+    destroyMatrix(tg.m[1]);
+    destroyTaskGraph(g);
+
+    return tg.lastTerm;
+}
+
+int multiProcess(
+    ParsedParams *params,
+    const Matrix *globalA,
+    Matrix **globalS,
+    int myrank,
+    int npes,
+    MPI_Comm comm)
+{
     // Number of rows for each process
     long nRowsPerProcess = 0;
 
@@ -28,26 +557,124 @@ int multiProcess(
 
     int res = OK;
 
-    /**
-     * MPI_Requests to control delivery
-     */
-    MPI_Request mSendRequest, mRecvRequest;
-
     // Data distribution
-    nColumnsPerProcess = calculateColumnsPerProcess(params->n, npes);
+    // The tiled layout needs whole tiles on every process
+    nColumnsPerProcess = calculateColumnsPerProcess(params->n, params->tiled ? npes * TILE_SIZE : npes);
 
     nRowsPerProcess = nColumnsPerProcess / npes;
 
     dataLength = nRowsPerProcess * nColumnsPerProcess;
 
+    /**
+     * Moves the M_k blocks between the processes.
+     * The transport may reorder the processes, so from here on we use
+     * its communicator and rank
+     */
+    Transport *t = createTransport(params->transport,
+                                   comm,
+                                   nRowsPerProcess,
+                                   nColumnsPerProcess,
+                                   params->position);
+
+    myrank = t->myrank;
+
     // Allocate buffers
     Matrix *a = createMatrixFilledWithZeros(nRowsPerProcess, nColumnsPerProcess);
-    Matrix *s = createMatrixFilledWithZeros(nRowsPerProcess, nColumnsPerProcess);
 
-    shareA(globalA, a, myrank, npes);
+    // One S per t
+    Matrix **s = (Matrix **)malloc(sizeof(Matrix *) * params->nTimes);
+    for (int i = 0; i < params->nTimes; i++)
+    {
+        // Out-of-core S are created when A is on disk
+        s[i] = params->scratch == NULL ? createMatrixFilledWithZeros(nRowsPerProcess, nColumnsPerProcess) : NULL;
+    }
 
-    // Buffer for receving
-    recvBuffer = (double *)malloc(sizeof(double) * dataLength);
+    shareA(globalA, a, params->n, myrank, npes, t->comm);
+
+    /**
+     * Number of terms from the a-priori bound
+     */
+    long nTerms = 0;
+
+    if (params->aPriori)
+    {
+        nTerms = aPrioriTerms(a, maxAbsTime(params), params->tolerance, t->comm);
+
+        if (myrank == 0)
+        {
+            printf("A-priori bound: %ld terms\n", nTerms);
+        }
+    }
+
+    /**
+     * Compression of the ring messages: infinity norm of A and largest
+     * scaled M_k of the previous term, for the error bound
+     */
+    double norm = 0.0;
+    double previousMax = 0.0;
+
+    if (params->compression != COMPRESSION_NONE)
+    {
+        norm = maxRowSum(a);
+        MPI_Allreduce(MPI_IN_PLACE, &norm, 1, MPI_DOUBLE, MPI_MAX, t->comm);
+
+        t->compression = params->compression;
+    }
+
+    // From here on A, M_k and S are tiled, in panels of one block
+    if (params->tiled && params->scratch != NULL)
+    {
+        // A and S go to disk: the memory only holds the M_k blocks
+        Matrix *scratchA = createScratchMatrix(params->scratch, nRowsPerProcess, nColumnsPerProcess, 0);
+
+        for (int i = 0; i < params->nTimes; i++)
+        {
+            s[i] = createScratchMatrix(params->scratch, nRowsPerProcess, nColumnsPerProcess, 1);
+            res = s[i] == NULL ? NOK : res;
+        }
+
+        if (scratchA == NULL || res != OK)
+        {
+            printf("[ERROR] Process #%d could not create its files in %s\n", myrank, params->scratch);
+            MPI_Abort(t->comm, EXIT_FAILURE);
+        }
+
+        tileMatrixTo(a, scratchA, nRowsPerProcess);
+        destroyMatrix(a);
+        a = scratchA;
+
+        t->tiled = 1;
+        t->outOfCore = 1;
+    }
+    else if (params->tiled)
+    {
+        t->tiled = 1;
+        tileMatrix(a, nRowsPerProcess);
+    }
+
+    /**
+     * Strassen-Winograd is less accurate than the classic multiplication:
+     * only use it if the error on A * A is within the tolerance
+     * on every process
+     */
+    if (params->strassenCutoff > 0)
+    {
+        double error = strassenError(a, params->strassenCutoff);
+
+        MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_DOUBLE, MPI_MAX, t->comm);
+
+        if (error > params->tolerance)
+        {
+            if (myrank == 0)
+            {
+                printf("[WARNING] Strassen error %e is above the tolerance. Disabled.\n", error);
+            }
+        }
+        else
+        {
+            t->strassenCutoff = params->strassenCutoff;
+        }
+    }
 
     /**
      * Matrix to hold multiplied values and avoid having to allocate
@@ -56,136 +683,282 @@ int multiProcess(
     Matrix *multiplied = createMatrix(nRowsPerProcess, nColumnsPerProcess);
 
     long d = multiplied->nRows * multiplied->nColumns;
-    double *zeroes = (double *)malloc(sizeof(double) * d);
+    double *zeroes = NULL;
 
-    fillArrayWithZeros(zeroes, d);
+    // Out of core we keep as few blocks as possible in memory
+    if (params->scratch == NULL)
+    {
+        zeroes = (double *)allocateTracked(sizeof(double) * d, MEMORY_ZEROES);
+        fillArrayWithZeros(zeroes, d);
+    }
 
     /**
      * M_k submatrix
      * M1 = A
      */
-    Matrix *m = duplicateMatrix(a);
+    Matrix *m = t->m;
+    memcpy(m->data, a->data, sizeof(double) * dataLength);
+    transportPublish(t);
 
-    // S1 = I + M1
-    setIdentitySubMatrix(s, myrank * nRowsPerProcess, 0);
-    sumMatrix(m, s);
+    // Nobody may read M1 before everyone has written it
+    MPI_Barrier(t->comm);
 
-    long k = 2;
-    int gonogo = PROCESS_CONTINUE;
+    /**
+     * t^k for each t
+     */
+    double *powers = (double *)malloc(sizeof(double) * params->nTimes);
+
+    /**
+     * Largest t^k: the stop condition is scale * M_k <= tolerance
+     */
+    double scale;
 
-    do
+    // S1 = I + t M1
+    for (int i = 0; i < params->nTimes; i++)
     {
-        // Reset multiplication matrix
-        memcpy(multiplied->data, zeroes, sizeof(double) * d);
+        powers[i] = 1.0;
 
-        for (int p = 0; p < npes; p++)
+        if (params->scratch != NULL)
         {
-            if (p < npes - 1)
+            // The files are zero filled: only the diagonal is set
+            for (long row = 0; row < nRowsPerProcess; row++)
             {
-                // Send / retrieve the next m
-                MPI_Irecv(recvBuffer,
-                          dataLength,
-                          MPI_DOUBLE,
-                          (myrank + 1) % npes,
-                          MESSAGE_TAG_M_LINE,
-                          MPI_COMM_WORLD,
-                          &mRecvRequest);
-
-                MPI_Isend(m->data,
-                          dataLength,
-                          MPI_DOUBLE,
-                          (npes + myrank - 1) % npes,
-                          MESSAGE_TAG_M_LINE,
-                          MPI_COMM_WORLD,
-                          &mSendRequest);
+                s[i]->data[tiledIndex(row, myrank * nRowsPerProcess + row, nRowsPerProcess, nRowsPerProcess)] = 1.0;
             }
+            continue;
+        }
 
-            multiplyMatrixAndSumBlock(a,
-                                      m,
-                                      multiplied,
-                                      0,
-                                      ((myrank + p) % npes) * nRowsPerProcess,
-                                      0,
-                                      0,
-                                      0,
-                                      0,
-                                      a->nRows,
-                                      m->nRows,
-                                      m->nColumns);
-
-            if (p < npes - 1)
-            {
-                MPI_Wait(&mRecvRequest, MPI_STATUS_IGNORE);
-                MPI_Wait(&mSendRequest, MPI_STATUS_IGNORE);
+        setIdentitySubMatrix(s[i], myrank * nRowsPerProcess, 0);
 
-                tmp = m->data;
-                m->data = recvBuffer;
-                recvBuffer = tmp;
-            }
+        if (params->tiled)
+        {
+            tileMatrix(s[i], nRowsPerProcess);
+        }
+    }
+    scale = sumTaylorTerm(m, s, params->times, powers, params->nTimes);
+
+    long k = 2;
+    int gonogo = PROCESS_CONTINUE;
+
+    /**
+     * Live metrics (-M), written by process #0
+     */
+    Metrics *metrics = NULL;
+
+    if (params->metricsFile != NULL && myrank == 0)
+    {
+        metrics = createMetrics(params->metricsFile,
+                                params->n,
+                                npes,
+                                params->tolerance,
+                                params->transport == TRANSPORT_RING);
+    }
+
+    if (params->taskGraph)
+    {
+        // Every term as a task graph, instead of the loop below. It has
+        // its own copies of M_k: the ring's buffers aren't needed.
+        transportReleaseBuffers(t);
+        destroyMatrix(multiplied);
+        freeTracked(zeroes);
+        multiplied = NULL;
+        zeroes = NULL;
+
+        long last = taskGraphTerms(params, t, a, s, powers, nTerms, metrics);
+
+        if (myrank == 0)
+        {
+            printf("Task graph: %ld terms\n", last);
+        }
+
+        gonogo = PROCESS_STOP;
+    }
+
+    while (gonogo == PROCESS_CONTINUE)
+    {
+        double multiplyTime = t->multiplyTime;
+
+        // Largest scaled M_k(i,j), if the stop condition needs it
+        double max = NAN;
+
+        // Reset multiplication matrix
+        if (zeroes != NULL)
+        {
+            memcpy(multiplied->data, zeroes, sizeof(double) * d);
+        }
+        else
+        {
+            fillArrayWithZeros(multiplied->data, d);
         }
 
+        transportMultiply(t, a, multiplied);
+
         // M_k = A * M_k-1 / k
-        tmp = m->data;
-        m->data = multiplied->data;
-        multiplied->data = tmp;
+        transportSwap(t, multiplied);
 
         divideMatrixByLong(m, k);
 
-        // S_k = S_k-1 + M_k
-        sumMatrix(m, s);
+        transportPublish(t);
 
-        double max = maxMij(m);
+        // S_k = S_k-1 + t^k M_k
+        scale = sumTaylorTerm(m, s, params->times, powers, params->nTimes);
 
-        // Stop or continue?
-        if (myrank == 0)
+        if (params->aPriori && k < nTerms)
+        {
+            // The bound says we are not done yet
+            transportSync(t);
+        }
+        else if (params->aPriori && !params->finalCheck)
         {
-            MPI_Reduce(MPI_IN_PLACE,
-                       &max,
-                       1,
-                       MPI_DOUBLE,
-                       MPI_MAX,
-                       0,
-                       MPI_COMM_WORLD);
+            gonogo = PROCESS_STOP;
+        }
+        else
+        {
+            max = maxMij(m) * scale;
 
-            if (max <= params->tolerance)
+            // Stop or continue?
+            if (myrank == 0)
+            {
+                MPI_Reduce(MPI_IN_PLACE,
+                           &max,
+                           1,
+                           MPI_DOUBLE,
+                           MPI_MAX,
+                           0,
+                           t->comm);
+
+                if (max <= params->tolerance)
+                {
+                    // Stop
+                    gonogo = PROCESS_STOP;
+                }
+            }
+            else
             {
-                // Stop
-                gonogo = PROCESS_STOP;
+                MPI_Reduce(&max,
+                           &max,
+                           1,
+                           MPI_DOUBLE,
+                           MPI_MAX,
+                           0,
+                           t->comm);
             }
+
+            MPI_Bcast(
+                &gonogo,
+                1,
+                MPI_INT,
+                0,
+                t->comm);
         }
-        else
+
+        if (params->compression != COMPRESSION_NONE && gonogo == PROCESS_CONTINUE)
         {
-            MPI_Reduce(&max,
-                       &max,
-                       1,
-                       MPI_DOUBLE,
-                       MPI_MAX,
-                       0,
-                       MPI_COMM_WORLD);
+            setCompressionError(t, m, scale * maxAbsTime(params), norm, k, params->tolerance, &previousMax);
         }
 
-        MPI_Bcast(
-            &gonogo,
-            1,
-            MPI_INT,
-            0,
-            MPI_COMM_WORLD);
+        if (params->metricsFile != NULL)
+        {
+            reportMetrics(metrics, k, max, t->sentBytes, t->multiplyTime - multiplyTime, nTerms, myrank, npes, t->comm);
+        }
+
+        if (params->adaptive && gonogo == PROCESS_CONTINUE && (k - 1) % ADAPTIVE_CHECK_TERMS == 0)
+        {
+            if (rebalanceRows(t, &a, s, params->nTimes, &multiplied, &zeroes) == OK)
+            {
+                m = t->m;
+                d = multiplied->nRows * multiplied->nColumns;
+            }
+        }
 
         k++;
-    } while (gonogo == PROCESS_CONTINUE);
+    }
+
+    destroyMetrics(metrics);
+
+    if (params->compression != COMPRESSION_NONE)
+    {
+        double bytes[2] = {t->sentBytes, t->rawBytes};
+
+        MPI_Allreduce(MPI_IN_PLACE, bytes, 2, MPI_DOUBLE, MPI_SUM, t->comm);
 
-    // Build final S matrix
-    res = buildFinalSMatrix(globalS, s, myrank, npes);
+        if (myrank == 0 && bytes[1] > 0.0)
+        {
+            printf("Ring messages: %.0f bytes, %.1f%% of uncompressed\n", bytes[0], 100.0 * bytes[0] / bytes[1]);
+        }
+    }
+
+    // Build final S matrices
+    for (int i = 0; i < params->nTimes && res == OK; i++)
+    {
+        if (params->scratch != NULL)
+        {
+            // One row-major S at a time, in the memory of multiplied
+            untileMatrixTo(s[i], multiplied, nRowsPerProcess);
+            res = buildFinalSMatrix(myrank == 0 ? globalS[i] : NULL, multiplied, myrank, npes, t->comm);
+            continue;
+        }
 
-    destroyMatrix(a);
-    destroyMatrix(s);
-    destroyMatrix(m);
+        if (params->tiled)
+        {
+            untileMatrix(s[i], nRowsPerProcess);
+        }
+
+        res = buildFinalSMatrix(myrank == 0 ? globalS[i] : NULL, s[i], myrank, npes, t->comm);
+    }
+
+    if (params->scratch != NULL)
+    {
+        destroyScratchMatrix(a);
+        for (int i = 0; i < params->nTimes; i++)
+        {
+            destroyScratchMatrix(s[i]);
+        }
+    }
+    else
+    {
+        destroyMatrix(a);
+        for (int i = 0; i < params->nTimes; i++)
+        {
+            destroyMatrix(s[i]);
+        }
+    }
+    free(s);
+    free(powers);
     destroyMatrix(multiplied);
-    free(recvBuffer);
+    freeTracked(zeroes);
+    destroyTransport(t);
 
     return res;
 }
 
+int setCompressionError(Transport *t,
+                        const Matrix *m,
+                        double scale,
+                        double norm,
+                        long k,
+                        double tolerance,
+                        double *previousMax)
+{
+    double max = maxMij(m) * scale;
+
+    MPI_Allreduce(MPI_IN_PLACE, &max, 1, MPI_DOUBLE, MPI_MAX, t->comm);
+
+    double ratio = *previousMax > 0.0 ? max / *previousMax : 1.0;
+    *previousMax = max;
+
+    if (ratio >= 1.0 || norm <= 0.0)
+    {
+        // The terms still grow and so would the errors
+        t->compressionError = 0.0;
+        return OK;
+    }
+
+    t->compressionError = COMPRESSION_ERROR * tolerance * (1.0 - ratio) * (k + 1) / (norm * scale);
+
+    return OK;
+}
+
 long calculateColumnsPerProcess(long n, int npes)
 {
 
@@ -197,15 +970,22 @@ long calculateColumnsPerProcess(long n, int npes)
     return ((n / npes) + 1) * npes;
 }
 
-int shareA(const Matrix *globalA, Matrix *a, int myrank, int npes)
+int shareA(const Matrix *globalA, Matrix *a, long n, int myrank, int npes, MPI_Comm comm)
 {
 
-    int *sendcounts, *displs;
+    int *sendcounts = NULL, *displs = NULL;
 
-    Matrix *aToSend = NULL;
-    double *data = globalA->data;
+    // Rows of A
+    MPI_Datatype rowType = createRowType(n);
 
-    long dataLength = a->nRows * a->nColumns;
+    // n values at the start of each of our longer rows
+    MPI_Datatype paddedRowType;
+    MPI_Type_create_resized(rowType, 0, sizeof(double) * a->nColumns, &paddedRowType);
+    MPI_Type_commit(&paddedRowType);
+
+    // The last processes may get fewer rows of A, or none
+    long myRows = n - myrank * a->nRows;
+    myRows = myRows < 0 ? 0 : (myRows > a->nRows ? a->nRows : myRows);
 
     if (myrank == 0)
     {
@@ -215,59 +995,104 @@ int shareA(const Matrix *globalA, Matrix *a, int myrank, int npes)
         displs = (int *)malloc(npes * sizeof(int));
         for (int i = 0; i < npes; i++)
         {
-            sendcounts[i] = dataLength;
-            displs[i] = i * dataLength;
-        }
-
-        // We need to adjust input data to our new internal size?
-        if (a->nColumns != globalA->nColumns)
-        {
-            aToSend = createMatrixFilledWithZeros(
-                a->nColumns,
-                a->nColumns);
-
-            copySubMatrix(aToSend,
-                          globalA,
-                          0,
-                          0,
-                          0,
-                          0,
-                          globalA->nRows,
-                          globalA->nColumns);
+            long rows = n - i * a->nRows;
 
-            data = aToSend->data;
+            sendcounts[i] = rows < 0 ? 0 : (rows > a->nRows ? a->nRows : rows);
+            displs[i] = sendcounts[i] > 0 ? i * a->nRows : 0;
         }
     }
 
     // Scatter the a array by the processes using the distribution set
     // by the sendcounts and displs arrays
-    MPI_Scatterv(data,
+    MPI_Scatterv(myrank == 0 ? globalA->data : NULL,
                  sendcounts,
                  displs,
-                 MPI_DOUBLE,
+                 rowType,
                  a->data,
-                 dataLength,
-                 MPI_DOUBLE,
+                 myRows,
+                 paddedRowType,
                  0,
-                 MPI_COMM_WORLD);
+                 comm);
 
     if (myrank == 0)
     {
-        destroyMatrix(aToSend);
         free(sendcounts);
         free(displs);
     }
 
+    MPI_Type_free(&paddedRowType);
+    MPI_Type_free(&rowType);
+
     return OK;
 }
 
-int buildFinalSMatrix(Matrix *globalS, Matrix *s, int myrank, int npes)
+long aPrioriTerms(const Matrix *a, double scale, double tolerance, MPI_Comm comm)
+{
+    // Infinity norm
+    double norm = maxRowSum(a);
+    MPI_Allreduce(MPI_IN_PLACE, &norm, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    // 1-norm
+    double *sums = (double *)malloc(sizeof(double) * a->nColumns);
+    fillArrayWithZeros(sums, a->nColumns);
+    addColumnSums(a, sums);
+    MPI_Allreduce(MPI_IN_PLACE, sums, a->nColumns, MPI_DOUBLE, MPI_SUM, comm);
+
+    double norm1 = 0.0;
+    for (long j = 0; j < a->nColumns; j++)
+    {
+        if (sums[j] > norm1)
+        {
+            norm1 = sums[j];
+        }
+    }
+
+    if (norm1 < norm)
+    {
+        norm = norm1;
+    }
+
+    free(sums);
+
+    return termsForTolerance(norm * scale, tolerance);
+}
+
+int buildFinalSMatrix(Matrix *globalS, Matrix *s, int myrank, int npes, MPI_Comm comm)
 {
+    long *rowCounts = NULL;
+    long nRows = s->nRows;
 
-    long dataLength = s->nRows * s->nColumns;
+    MPI_Datatype rowType = createRowType(s->nColumns);
 
     if (myrank == 0)
     {
+        rowCounts = (long *)malloc(sizeof(long) * npes);
+    }
+
+    // The processes may have different numbers of rows
+    MPI_Gather(&nRows, 1, MPI_LONG, rowCounts, 1, MPI_LONG, 0, comm);
+
+    if (myrank == 0)
+    {
+        long offset = s->nRows;
+        long maxRows = s->nRows;
+
+        for (int p = 1; p < npes; p++)
+        {
+            if (rowCounts[p] > maxRows)
+            {
+                maxRows = rowCounts[p];
+            }
+        }
+
+        // Buffer for the blocks that don't fit directly in globalS
+        Matrix *recvBuffer = NULL;
+
+        if (s->nColumns != globalS->nColumns)
+        {
+            recvBuffer = createMatrixInCategory(maxRows, s->nColumns, MEMORY_BUFFERS);
+        }
+
         copySubMatrix(globalS,
                       s,
                       0,
@@ -281,45 +1106,288 @@ int buildFinalSMatrix(Matrix *globalS, Matrix *s, int myrank, int npes)
         {
             if (s->nColumns == globalS->nColumns)
             {
-                MPI_Recv(globalS->data + p * dataLength,
-                         dataLength,
-                         MPI_DOUBLE,
+                MPI_Recv(globalS->data + offset * s->nColumns,
+                         rowCounts[p],
+                         rowType,
                          p,
                          MESSAGE_TAG_S_FINAL_LINE,
-                         MPI_COMM_WORLD,
+                         comm,
                          MPI_STATUS_IGNORE);
             }
             else
             {
-                MPI_Recv(s->data,
-                         dataLength,
-                         MPI_DOUBLE,
+                recvBuffer->nRows = rowCounts[p];
+
+                MPI_Recv(recvBuffer->data,
+                         rowCounts[p],
+                         rowType,
                          p,
                          MESSAGE_TAG_S_FINAL_LINE,
-                         MPI_COMM_WORLD,
+                         comm,
                          MPI_STATUS_IGNORE);
 
                 // We can't swap: the matrices don't have the same dimensions
                 copySubMatrix(globalS,
-                              s,
-                              s->nRows * p,
+                              recvBuffer,
+                              offset,
                               0,
                               0,
                               0,
                               globalS->nRows,
                               globalS->nColumns);
             }
+
+            offset += rowCounts[p];
         }
+
+        destroyMatrix(recvBuffer);
+        free(rowCounts);
     }
     else
     {
         MPI_Send(s->data,
-                 dataLength,
-                 MPI_DOUBLE,
+                 s->nRows,
+                 rowType,
                  0,
                  MESSAGE_TAG_S_FINAL_LINE,
-                 MPI_COMM_WORLD);
+                 comm);
+    }
+
+    MPI_Type_free(&rowType);
+
+    return OK;
+}
+
+/**
+ * Number of rows of the block [start1, start1 + count1) that are
+ * also in [start2, start2 + count2)
+ */
+static long overlap(long start1, long count1, long start2, long count2)
+{
+    long start = start1 > start2 ? start1 : start2;
+    long end = start1 + count1 < start2 + count2 ? start1 + count1 : start2 + count2;
+
+    return end > start ? end - start : 0;
+}
+
+Matrix *redistributeRows(const Matrix *old,
+                         const long *oldCounts,
+                         const long *newCounts,
+                         long capacityRows,
+                         int myrank,
+                         int npes,
+                         MPI_Comm comm)
+{
+    int *sendcounts = (int *)malloc(sizeof(int) * npes);
+    int *sdispls = (int *)malloc(sizeof(int) * npes);
+    int *recvcounts = (int *)malloc(sizeof(int) * npes);
+    int *rdispls = (int *)malloc(sizeof(int) * npes);
+
+    long *oldOffsets = (long *)malloc(sizeof(long) * npes);
+    long *newOffsets = (long *)malloc(sizeof(long) * npes);
+
+    oldOffsets[0] = newOffsets[0] = 0;
+    for (int p = 1; p < npes; p++)
+    {
+        oldOffsets[p] = oldOffsets[p - 1] + oldCounts[p - 1];
+        newOffsets[p] = newOffsets[p - 1] + newCounts[p - 1];
+    }
+
+    for (int p = 0; p < npes; p++)
+    {
+        // Our old rows that p now owns
+        sendcounts[p] = overlap(oldOffsets[myrank], oldCounts[myrank], newOffsets[p], newCounts[p]);
+        sdispls[p] = sendcounts[p] > 0
+                         ? (newOffsets[p] > oldOffsets[myrank] ? newOffsets[p] : oldOffsets[myrank]) - oldOffsets[myrank]
+                         : 0;
+
+        // p's old rows that we now own
+        recvcounts[p] = overlap(oldOffsets[p], oldCounts[p], newOffsets[myrank], newCounts[myrank]);
+        rdispls[p] = recvcounts[p] > 0
+                         ? (oldOffsets[p] > newOffsets[myrank] ? oldOffsets[p] : newOffsets[myrank]) - newOffsets[myrank]
+                         : 0;
     }
 
+    Matrix *m = createMatrix(capacityRows, old->nColumns);
+    m->nRows = newCounts[myrank];
+
+    MPI_Datatype rowType = createRowType(old->nColumns);
+
+    MPI_Alltoallv(old->data,
+                  sendcounts,
+                  sdispls,
+                  rowType,
+                  m->data,
+                  recvcounts,
+                  rdispls,
+                  rowType,
+                  comm);
+
+    MPI_Type_free(&rowType);
+
+    free(sendcounts);
+    free(sdispls);
+    free(recvcounts);
+    free(rdispls);
+    free(oldOffsets);
+    free(newOffsets);
+
+    return m;
+}
+
+int rebalanceRows(Transport *t, Matrix **a, Matrix **s, int nS, Matrix **multiplied, double **zeroes)
+{
+    // Only the ring can change the distribution
+    if (t->type != TRANSPORT_RING)
+    {
+        return NOK;
+    }
+
+    int npes = t->npes;
+    double *times = (double *)malloc(sizeof(double) * npes);
+    long *newCounts = (long *)malloc(sizeof(long) * npes);
+
+    MPI_Allgather(&t->multiplyTime, 1, MPI_DOUBLE, times, 1, MPI_DOUBLE, t->comm);
+    t->multiplyTime = 0.0;
+
+    double minTime = times[0], maxTime = times[0];
+    for (int p = 1; p < npes; p++)
+    {
+        minTime = times[p] < minTime ? times[p] : minTime;
+        maxTime = times[p] > maxTime ? times[p] : maxTime;
+    }
+
+    if (minTime <= 0.0 || maxTime <= minTime * (1 + ADAPTIVE_IMBALANCE))
+    {
+        // Balanced enough
+        free(times);
+        free(newCounts);
+        return NOK;
+    }
+
+    // Rows per second of each process
+    double totalThroughput = 0.0;
+    long totalRows = 0;
+    int fastest = 0;
+
+    for (int p = 0; p < npes; p++)
+    {
+        times[p] = t->rowCounts[p] / times[p];
+        totalThroughput += times[p];
+        totalRows += t->rowCounts[p];
+
+        if (times[p] > times[fastest])
+        {
+            fastest = p;
+        }
+    }
+
+    long assigned = 0;
+    int changed = 0;
+
+    for (int p = 0; p < npes; p++)
+    {
+        newCounts[p] = (long)(totalRows * times[p] / totalThroughput);
+        if (newCounts[p] < 1)
+        {
+            newCounts[p] = 1;
+        }
+        assigned += newCounts[p];
+    }
+
+    // The rows given to the clamped processes come from the ones with
+    // the most rows
+    while (assigned > totalRows)
+    {
+        int largest = 0;
+
+        for (int p = 1; p < npes; p++)
+        {
+            largest = newCounts[p] > newCounts[largest] ? p : largest;
+        }
+
+        if (newCounts[largest] <= 1)
+        {
+            break;
+        }
+
+        newCounts[largest]--;
+        assigned--;
+    }
+
+    // Rounding leftovers go to the fastest process
+    if (assigned < totalRows)
+    {
+        newCounts[fastest] += totalRows - assigned;
+        assigned = totalRows;
+    }
+
+    // Every process keeps at least one row and no row is lost
+    for (int p = 0; p < npes; p++)
+    {
+        changed |= newCounts[p] != t->rowCounts[p];
+
+        if (newCounts[p] < 1)
+        {
+            assigned = -1;
+        }
+    }
+
+    if (!changed || assigned != totalRows)
+    {
+        free(times);
+        free(newCounts);
+        return NOK;
+    }
+
+    long minRows = newCounts[0], maxRows = newCounts[0];
+    for (int p = 1; p < npes; p++)
+    {
+        minRows = newCounts[p] < minRows ? newCounts[p] : minRows;
+        maxRows = newCounts[p] > maxRows ? newCounts[p] : maxRows;
+    }
+
+    Matrix *newA = redistributeRows(*a, t->rowCounts, newCounts, newCounts[t->myrank], t->myrank, npes, t->comm);
+
+    // The M_k blocks rotate through the buffers: they need room for the largest one
+    Matrix *newM = redistributeRows(t->m, t->rowCounts, newCounts, maxRows, t->myrank, npes, t->comm);
+
+    for (int i = 0; i < nS; i++)
+    {
+        Matrix *newS = redistributeRows(s[i], t->rowCounts, newCounts, newCounts[t->myrank], t->myrank, npes, t->comm);
+        destroyMatrix(s[i]);
+        s[i] = newS;
+    }
+
+    destroyMatrix(*a);
+    destroyMatrix(*multiplied);
+    freeTracked(*zeroes);
+
+    *a = newA;
+
+    // multiplied swaps its data with M_k
+    *multiplied = createMatrix(maxRows, newM->nColumns);
+    (*multiplied)->nRows = newM->nRows;
+
+    long d = newM->nRows * newM->nColumns;
+    *zeroes = (double *)allocateTracked(sizeof(double) * d, MEMORY_ZEROES);
+    fillArrayWithZeros(*zeroes, d);
+
+    if (transportSetDistribution(t, newCounts, newM) != OK)
+    {
+        destroyMatrix(newM);
+        free(times);
+        free(newCounts);
+        return NOK;
+    }
+
+    if (t->myrank == 0)
+    {
+        printf("Rebalanced rows: %ld to %ld rows per process\n", minRows, maxRows);
+    }
+
+    free(times);
+    free(newCounts);
+
     return OK;
 }
@@ -5,13 +5,24 @@
 #include <stdio.h>
 
 #include "matrix.h"
+#include "memory.h"
 #include "parse_param.h"
+#include "transport.h"
+#include "out_of_core.h"
+#include "scheduler.h"
+#include "metrics.h"
 
+/**
+ * Calculates globalS[i] = exp(t_i globalA) for each params->times[i]
+ * using the npes processes of comm.
+ * globalA and globalS are only used on the process with rank 0.
+ */
 int multiProcess(ParsedParams *params,
                  const Matrix *globalA,
-                 Matrix *globalS,
+                 Matrix **globalS,
                  int myrank,
-                 int npes);
+                 int npes,
+                 MPI_Comm comm);
 
 /**
  * Calculates the number of columns to use.
@@ -20,17 +31,62 @@ int multiProcess(ParsedParams *params,
 long calculateColumnsPerProcess(long n, int npes);
 
 /**
- * Shares the A matrix using MPI_Scatterv
- * If necessary (n!=nColumnsPerProcess) the values are adjusted for the
- * new internal dimensions
+ * Shares the n x n A matrix using MPI_Scatterv
+ * If necessary (n!=nColumnsPerProcess) the rows are received into the
+ * new internal dimensions: the extra rows and columns of a are left as
+ * they are (zero), without a padded copy of A on process #0
  */
-int shareA(const Matrix *globalA, Matrix *a, int myrank, int npes);
+int shareA(const Matrix *globalA, Matrix *a, long n, int myrank, int npes, MPI_Comm comm);
 
 /**
  * Builds the final S Matrix using the s data from each subprocess
  * If necessary (n!=nColumnsPerProcess) the values are adjusted to the
  * original dimensions
  */
-int buildFinalSMatrix(Matrix *globalS, Matrix *s, int myrank, int npes);
+int buildFinalSMatrix(Matrix *globalS, Matrix *s, int myrank, int npes, MPI_Comm comm);
+
+/**
+ * Moves the rows of old from the oldCounts distribution to the
+ * newCounts one (rows per process, in rank order).
+ * The new matrix has room for capacityRows rows.
+ */
+Matrix *redistributeRows(const Matrix *old,
+                         const long *oldCounts,
+                         const long *newCounts,
+                         long capacityRows,
+                         int myrank,
+                         int npes,
+                         MPI_Comm comm);
+
+/**
+ * Gives each process a number of rows proportional to its multiply
+ * throughput since the last call, if the multiply times differ by
+ * more than ADAPTIVE_IMBALANCE. A, the nS S matrices, M_k, multiplied
+ * and zeroes are replaced. Only the ring transport supports it.
+ * Returns OK if the rows were moved.
+ */
+int rebalanceRows(Transport *t, Matrix **a, Matrix **s, int nS, Matrix **multiplied, double **zeroes);
+
+/**
+ * Error bound for the compressed M_k blocks sent in the next term.
+ * An error e in M_k adds up to norm * e / (k+1) to M_k+1, and while
+ * the terms decay by ratio each term the later terms add up to
+ * 1 / (1 - ratio) times that. scale is the largest t^(k+1).
+ * The blocks go uncompressed while the terms still grow.
+ */
+int setCompressionError(Transport *t,
+                        const Matrix *m,
+                        double scale,
+                        double norm,
+                        long k,
+                        double tolerance,
+                        double *previousMax);
+
+/**
+ * Number of terms needed for the tolerance, from the smallest of the
+ * 1-norm and infinity norm of the distributed scale * A.
+ * Every process gets the same value.
+ */
+long aPrioriTerms(const Matrix *a, double scale, double tolerance, MPI_Comm comm);
 
 #endif
@@ -0,0 +1,79 @@
+#include "out_of_core.h"
+
+/**
+ * Page aligned range holding length values from data, for madvise
+ */
+static void adviseRange(const double *data, long length, int advice)
+{
+    long pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)data & ~(uintptr_t)(pageSize - 1);
+    uintptr_t end = (uintptr_t)(data + length);
+
+    if (length > 0)
+    {
+        madvise((void *)start, end - start, advice);
+    }
+}
+
+Matrix *createScratchMatrix(const char *dir, long nRows, long nColumns, int sequential)
+{
+    char path[4096];
+    size_t size = sizeof(double) * nRows * nColumns;
+
+    snprintf(path, sizeof(path), "%s/expm-XXXXXX", dir);
+
+    int fd = mkstemp(path);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    // The mapping keeps the data until it is unmapped
+    unlink(path);
+
+    // A new file reads as zeros
+    if (ftruncate(fd, size > 0 ? size : 1) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, size > 0 ? size : 1, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    madvise(data, size > 0 ? size : 1, sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+
+    Matrix *m = (Matrix *)malloc(sizeof(Matrix));
+    m->nRows = nRows;
+    m->nColumns = nColumns;
+    m->data = (double *)data;
+
+    return m;
+}
+
+void destroyScratchMatrix(Matrix *m)
+{
+    if (m == NULL)
+    {
+        return;
+    }
+
+    size_t size = sizeof(double) * m->nRows * m->nColumns;
+    munmap(m->data, size > 0 ? size : 1);
+    free(m);
+}
+
+void prefetchScratch(const double *data, long length)
+{
+    adviseRange(data, length, MADV_WILLNEED);
+}
+
+void releaseScratch(const double *data, long length)
+{
+    adviseRange(data, length, MADV_DONTNEED);
+}
@@ -0,0 +1,50 @@
+#ifndef __OUT_OF_CORE_H__
+#define __OUT_OF_CORE_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "util.h"
+#include "matrix.h"
+
+/**
+ * Out-of-core storage (-O) for the largest matrices: A and S of each
+ * process and the global A and S of process #0.
+ *
+ * Their data is a shared mapping of a file in the scratch directory, so
+ * the kernel pages it in and writes it back as needed and it doesn't
+ * have to fit in memory. The file is removed as soon as it is created:
+ * nothing is left behind, even if the program dies.
+ *
+ * A uses the tiled layout (-Z): the panel multiplied by each M_k block
+ * is contiguous and is read ahead while the previous one is multiplied,
+ * then dropped from our working set. The S are read and written from
+ * start to end on every term.
+ */
+
+/**
+ * Creates a zero filled matrix backed by a file in dir.
+ * sequential tells the kernel the data is read from start to end.
+ * Returns NULL if the file can't be created.
+ */
+Matrix *createScratchMatrix(const char *dir, long nRows, long nColumns, int sequential);
+
+void destroyScratchMatrix(Matrix *m);
+
+/**
+ * Starts reading length values of a scratch matrix from disk
+ */
+void prefetchScratch(const double *data, long length);
+
+/**
+ * Drops length values of a scratch matrix from our working set.
+ * Modified data is still written back to the file.
+ */
+void releaseScratch(const double *data, long length);
+
+#endif
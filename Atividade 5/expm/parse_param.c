@@ -2,7 +2,8 @@
 
 void printUsageMessage(const char *programName)
 {
-    printf("USAGE: %s -s seed -n dimension -o output-filename [-t tolerance]\n",
+    printf("USAGE: %s -s seed -n dimension -o output-filename [-t tolerance] [-c ring|shm|rma] [-w strassen-cutoff] [-a [-f]] [-F] [-W] [-l] [-P] [-T t1,t2,...] [-p] [-B] [-d density] [-Z] [-z float|quant] [-N] [-j threads] [-b builtin|blas|check] [-O scratch-dir] [-U steps,size[,rank]] [-C cache-dir[,MB]] [-G] [-M metrics-file] [--dry-run[=processes]]\n       %s -E problem-list[,group-size] [options]\n",
+           programName,
            programName);
 }
 
@@ -29,14 +30,46 @@ ParsedParams getParams(int rank, int argc, char *argv[])
 
     ParsedParams params;
     params.tolerance = DEFAULT_TOLERANCE;
+    params.transport = TRANSPORT_RING;
+    params.transportChosen = 0;
+    params.strassenCutoff = 0;
+    params.aPriori = 0;
+    params.finalCheck = 0;
+    params.fullOutput = 0;
+    params.asyncOutput = 0;
+    params.adaptive = 0;
+    params.plan = 0;
+    params.profile = 0;
+    params.blockTriangular = 0;
+    params.density = 1.0;
+    params.tiled = 0;
+    params.compression = COMPRESSION_NONE;
+    params.numaAware = 0;
+    params.position = -1;
+    params.threads = 1;
+    params.backend = BACKEND_BUILTIN;
+    params.scratch = NULL;
+    params.updates = 0;
+    params.updateSize = 0.0;
+    params.updateRank = 0;
+    params.cacheDir = NULL;
+    params.cacheLimit = CACHE_DEFAULT_LIMIT * 1024L * 1024L;
+    params.ensembleFile = NULL;
+    params.groupSize = 1;
+    params.taskGraph = 0;
+    params.metricsFile = NULL;
+    params.dryRun = 0;
+    params.dryRunProcesses = 0;
+    params.times = (double *)malloc(sizeof(double));
+    params.times[0] = 1.0;
+    params.nTimes = 1;
 
-    // Check input arguments
-    if (argc < 4)
-    {
-        printErrorAndExit(rank, argv[0], "Required arguments missing.");
-    }
+    static struct option longOptions[] = {
+        { "dry-run", optional_argument, NULL, OPTION_DRY_RUN },
+        { NULL, 0, NULL, 0 }
+    };
 
-    while ((opt = getopt(argc, argv, "s:n:o:t:")) != -1)
+    while ((opt = getopt_long(argc, argv, "s:n:o:t:c:w:afFWlPT:pBd:Zz:Nj:b:O:U:C:E:GM:", longOptions, NULL)) != -1)
     {
         switch (opt)
         {
@@ -70,7 +103,7 @@ ParsedParams getParams(int rank, int argc, char *argv[])
                 printErrorAndExit(rank, argv[0], "Invalid output filename!");
             }
 
-            params.outputfile = (char *)malloc(sizeof(char) * strlen(outputfilename));
+            params.outputfile = (char *)malloc(sizeof(char) * (strlen(outputfilename) + 1));
             strcpy(params.outputfile, outputfilename);
             break;
         case 't':
@@ -81,8 +114,318 @@ ParsedParams getParams(int rank, int argc, char *argv[])
             }
 
             params.tolerance = tolerance;
+            break;
+        case 'c':
+            if (strcmp(optarg, "ring") == 0)
+            {
+                params.transport = TRANSPORT_RING;
+            }
+            else if (strcmp(optarg, "shm") == 0)
+            {
+                params.transport = TRANSPORT_SHM;
+            }
+            else if (strcmp(optarg, "rma") == 0)
+            {
+                params.transport = TRANSPORT_RMA;
+            }
+            else
+            {
+                printErrorAndExit(rank, argv[0], "Invalid transport. Use ring, shm or rma.");
+            }
+            params.transportChosen = 1;
+            break;
+        case 'w':
+            params.strassenCutoff = atol(optarg);
+            if (params.strassenCutoff < 0)
+            {
+                printErrorAndExit(rank,
+                                  argv[0],
+                                  "Invalid Strassen cutoff. Must be >= 0 (0 disables it).");
+            }
+            break;
+        case 'a':
+            // Number of terms from the a-priori bound
+            params.aPriori = 1;
+            break;
+        case 'f':
+            // Final convergence check after the a-priori terms
+            params.finalCheck = 1;
+            break;
+        case 'F':
+            // Write the full matrices to the output file
+            params.fullOutput = 1;
+            break;
+        case 'W':
+            // Write the matrices in a background thread
+            params.asyncOutput = 1;
+            break;
+        case 'l':
+            // Rows distributed by multiply throughput
+            params.adaptive = 1;
+            break;
+        case 'P':
+            // Number of processes and transport chosen by the planner
+            params.plan = 1;
+            break;
+        case 'p':
+            // Hardware counters around the matrix kernels
+            params.profile = 1;
+            break;
+        case 'B':
+            // Exponentiate the diagonal blocks of the block triangular form
+            params.blockTriangular = 1;
+            break;
+        case 'd':
+            params.density = atof(optarg);
+            if (params.density <= 0.0 || params.density > 1.0)
+            {
+                printErrorAndExit(rank, argv[0], "Invalid density. Must be > 0 and <= 1.");
+            }
+            break;
+        case 'Z':
+            // Tiled storage for the matrices
+            params.tiled = 1;
+            break;
+        case 'z':
+            if (strcmp(optarg, "float") == 0)
+            {
+                params.compression = COMPRESSION_FLOAT;
+            }
+            else if (strcmp(optarg, "quant") == 0)
+            {
+                params.compression = COMPRESSION_QUANTIZE;
+            }
+            else
+            {
+                printErrorAndExit(rank, argv[0], "Invalid compression. Use float or quant.");
+            }
+            break;
+        case 'N':
+            // Topology aware placement
+            params.numaAware = 1;
+            break;
+        case 'j':
+            // Threads per process for the multiplications (0: one per
+            // cpu the process can run on)
+            params.threads = atoi(optarg);
+            if (params.threads < 0)
+            {
+                printErrorAndExit(rank, argv[0], "Invalid number of threads. Must be >= 0.");
+            }
+            break;
+        case 'b':
+            if (strcmp(optarg, "builtin") == 0)
+            {
+                params.backend = BACKEND_BUILTIN;
+            }
+            else if (strcmp(optarg, "blas") == 0)
+            {
+                params.backend = BACKEND_CBLAS;
+            }
+            else if (strcmp(optarg, "check") == 0)
+            {
+                params.backend = BACKEND_CHECK;
+            }
+            else
+            {
+                printErrorAndExit(rank, argv[0], "Invalid backend. Use builtin, blas or check.");
+            }
+
+#ifndef USE_CBLAS
+            if (params.backend != BACKEND_BUILTIN)
+            {
+                printErrorAndExit(rank, argv[0], "Built without cblas: compile with -DUSE_CBLAS to use -b.");
+            }
+#endif
+            break;
+        case 'O':
+            // Out-of-core A and S in this directory
+            params.scratch = optarg;
+            break;
+        case 'U':
+            // Number of steps, size of the values of D and its rank
+            if (sscanf(optarg, "%d,%lf,%ld", &params.updates, &params.updateSize, &params.updateRank) < 2 ||
+                params.updates < 1 || params.updateSize <= 0.0 || params.updateRank < 0)
+            {
+                printErrorAndExit(rank, argv[0], "Invalid updates. Use -U steps,size[,rank] with steps >= 1 and size > 0.");
+            }
+            break;
+        case 'C':
+            // Cache directory and its size limit in MB
+            params.cacheDir = strtok(optarg, ",");
+            char *limit = strtok(NULL, ",");
+            if (limit != NULL)
+            {
+                params.cacheLimit = atol(limit) * 1024L * 1024L;
+            }
+
+            if (params.cacheDir == NULL || params.cacheLimit <= 0)
+            {
+                printErrorAndExit(rank, argv[0], "Invalid cache. Use -C directory[,MB] with MB > 0.");
+            }
+            break;
+        case 'E':
+            // List of problems and processes per problem
+            params.ensembleFile = strtok(optarg, ",");
+            char *size = strtok(NULL, ",");
+            if (size != NULL)
+            {
+                params.groupSize = atoi(size);
+            }
+
+            if (params.ensembleFile == NULL || params.groupSize < 1)
+            {
+                printErrorAndExit(rank, argv[0], "Invalid ensemble. Use -E problem-list[,group-size] with group-size >= 1.");
+            }
+            break;
+        case 'G':
+            // Terms as a task graph
+            params.taskGraph = 1;
+            break;
+        case 'M':
+            // Prometheus text file, rewritten after every term
+            params.metricsFile = optarg;
+            break;
+        case OPTION_DRY_RUN:
+            // Memory prediction, for this run or the given processes
+            params.dryRun = 1;
+
+            if (optarg != NULL)
+            {
+                params.dryRunProcesses = atoi(optarg);
+
+                if (params.dryRunProcesses < 1)
+                {
+                    printErrorAndExit(rank, argv[0], "Invalid number of processes. Use --dry-run[=processes] with processes >= 1.");
+                }
+            }
+            break;
+        case 'T':
+            // Comma separated list of t values
+            params.nTimes = 1;
+            for (char *c = optarg; *c != '\0'; c++)
+            {
+                params.nTimes += *c == ',';
+            }
+
+            params.times = (double *)realloc(params.times, sizeof(double) * params.nTimes);
+            params.nTimes = 0;
+
+            // Every field must be a finite number
+            for (char *value = optarg, *end = optarg; *end != '\0'; value = end + 1)
+            {
+                double time = strtod(value, &end);
+
+                if (end == value || (*end != ',' && *end != '\0') || !isfinite(time))
+                {
+                    printErrorAndExit(rank, argv[0], "Invalid list of t values. Use -T t1,t2,... with finite numbers.");
+                }
+
+                params.times[params.nTimes++] = time;
+            }
+
+            if (params.nTimes == 0)
+            {
+                printErrorAndExit(rank, argv[0], "Invalid list of t values.");
+            }
+            break;
+        }
+    }
+
+    // Check input arguments (the problems of an ensemble come from its
+    // list, a dry run only needs n)
+    if (params.ensembleFile == NULL && !params.dryRun && argc < 4)
+    {
+        printErrorAndExit(rank, argv[0], "Required arguments missing.");
+    }
+
+    if (params.dryRun && n <= 0)
+    {
+        printErrorAndExit(rank, argv[0], "--dry-run needs the dimension: -n dimension.");
+    }
+
+    if (params.dryRun && (params.blockTriangular || params.plan || params.adaptive || params.updates > 0 || params.ensembleFile != NULL))
+    {
+        printErrorAndExit(rank, argv[0], "--dry-run can't predict -B, -P, -l, -U or -E: their memory depends on A or on the machine.");
+    }
+
+    if (params.ensembleFile != NULL && (params.plan || params.updates > 0 || params.asyncOutput || params.metricsFile != NULL))
+    {
+        printErrorAndExit(rank, argv[0], "-E can't be used with -P, -U, -W or -M.");
+    }
+
+    if (params.finalCheck && !params.aPriori)
+    {
+        printErrorAndExit(rank, argv[0], "-f can only be used with -a.");
+    }
+
+    if (params.adaptive && params.transport != TRANSPORT_RING)
+    {
+        printErrorAndExit(rank, argv[0], "-l can only be used with the ring transport.");
+    }
+
+    if (params.compression != COMPRESSION_NONE && params.transport != TRANSPORT_RING)
+    {
+        printErrorAndExit(rank, argv[0], "-z can only be used with the ring transport.");
+    }
+
+    if (params.tiled && (params.strassenCutoff > 0 || params.adaptive || params.blockTriangular))
+    {
+        printErrorAndExit(rank, argv[0], "-Z can't be used with -w, -l or -B.");
+    }
+
+    if (params.taskGraph && (params.transport != TRANSPORT_RING || params.plan || params.tiled ||
+                             params.compression != COMPRESSION_NONE || params.adaptive))
+    {
+        printErrorAndExit(rank, argv[0], "-G replaces the ring transport: it can't be used with -c shm|rma, -P, -Z, -z or -l.");
+    }
+
+    if (params.scratch != NULL && !params.tiled)
+    {
+        printErrorAndExit(rank, argv[0], "-O can only be used with -Z.");
+    }
+
+    if (params.scratch != NULL && params.asyncOutput)
+    {
+        printErrorAndExit(rank, argv[0], "-O can't be used with -W: the writer keeps a copy of S in memory.");
+    }
+
+    if (params.updates > 0 && (params.nTimes != 1 || params.times[0] != 1.0))
+    {
+        printErrorAndExit(rank, argv[0], "-U can't be used with -T.");
+    }
+
+    if (params.updates > 0 && params.scratch != NULL)
+    {
+        printErrorAndExit(rank, argv[0], "-U can't be used with -O: the updates are done in memory.");
+    }
+
+    if (params.updates > 0)
+    {
+        // The exp(A / 2^l) come from the same Taylor terms as exp(A)
+        params.nTimes = UPDATE_LEVELS + 1;
+        params.times = (double *)realloc(params.times, sizeof(double) * params.nTimes);
+
+        for (int l = 0; l < params.nTimes; l++)
+        {
+            params.times[l] = ldexp(1.0, -l);
         }
     }
 
     return params;
 }
+
+double maxAbsTime(const ParsedParams *params)
+{
+    double max = 0.0;
+
+    for (int i = 0; i < params->nTimes; i++)
+    {
+        if (fabs(params->times[i]) > max)
+        {
+            max = fabs(params->times[i]);
+        }
+    }
+
+    return max;
+}
@@ -4,7 +4,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <mpi.h>
 #include "util.h"
 
@@ -14,6 +16,116 @@ typedef struct parse_param
     long n;
     char *outputfile;
     double tolerance;
+    int transport;
+
+    /**
+     * The transport was given with -c: the planner (-P) keeps it
+     */
+    int transportChosen;
+
+    long strassenCutoff;
+    int aPriori;
+    int finalCheck;
+    int fullOutput;
+    int asyncOutput;
+    int adaptive;
+    int plan;
+
+    /**
+     * Values of t for exp(t A). Just 1.0 by default.
+     */
+    double *times;
+    int nTimes;
+
+    /**
+     * Report the hardware counters of the matrix kernels (-p)
+     */
+    int profile;
+
+    /**
+     * Use the block triangular form of A (-B)
+     */
+    int blockTriangular;
+
+    /**
+     * Fraction of the entries of the random A that are kept (-d)
+     */
+    double density;
+
+    /**
+     * Tiled storage for the matrices of multiProcess (-Z)
+     */
+    int tiled;
+
+    /**
+     * Compression of the ring messages (-z)
+     */
+    int compression;
+
+    /**
+     * Pin the processes following the machine topology (-N).
+     * position is the place of our cpus in the topology order, set by
+     * placeProcess (-1 if not pinned).
+     */
+    int numaAware;
+    int position;
+
+    /**
+     * Threads per process for the multiplications (-j)
+     */
+    int threads;
+
+    /**
+     * Backend of the matrix kernels (-b)
+     */
+    int backend;
+
+    /**
+     * Scratch directory for the out-of-core A and S (-O), NULL if they
+     * are kept in memory
+     */
+    char *scratch;
+
+    /**
+     * Incremental updates (-U): number of steps, values of the random
+     * D in [-updateSize, updateSize] and rank of D (0: dense).
+     * times is then {1, 1/2, ..., 1/2^UPDATE_LEVELS}: the S[l] are kept
+     * for the updates.
+     */
+    int updates;
+    double updateSize;
+    long updateRank;
+
+    /**
+     * Result cache directory (-C, NULL if not used) and the largest size
+     * of its entries, in bytes
+     */
+    char *cacheDir;
+    long cacheLimit;
+
+    /**
+     * Ensemble mode (-E): list of problems (NULL if not used) and
+     * number of processes that solve each problem
+     */
+    char *ensembleFile;
+    int groupSize;
+
+    /**
+     * Run the terms of multiProcess as a task graph (-G)
+     */
+    int taskGraph;
+
+    /**
+     * File with the live metrics of the run (-M), NULL if not used
+     */
+    char *metricsFile;
+
+    /**
+     * Only print the predicted memory (--dry-run), for dryRunProcesses
+     * processes (0: the processes of this run)
+     */
+    int dryRun;
+    int dryRunProcesses;
 } ParsedParams;
 
 void printUsageMessage(const char *programName);
@@ -22,4 +134,9 @@ void printErrorAndExit(int rank, const char *programName, const char *message);
 
 ParsedParams getParams(int rank, int argc, char *argv[]);
 
+/**
+ * Largest |t| in params->times
+ */
+double maxAbsTime(const ParsedParams *params);
+
 #endif
@@ -0,0 +1,416 @@
+#include "perf_counters.h"
+
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "matrix.h"
+
+/**
+ * Totals of one kernel
+ */
+typedef struct perf_kernel
+{
+    double calls;
+    double time;
+    double flops;
+    double bytes;
+    double counts[PERF_N_COUNTERS];
+
+    /**
+     * Nesting depth and values when the outermost call started
+     */
+    int depth;
+    double startTime;
+    uint64_t startCounts[PERF_N_COUNTERS];
+} PerfKernel;
+
+static const char *kernelNames[PERF_N_KERNELS] = {"multiply", "sum", "divide"};
+
+static int perfEnabled = 0;
+
+/**
+ * Group leader (-1 if no counter could be opened) and position of each
+ * counter in the group read (-1 if unavailable)
+ */
+static int groupFd = -1;
+static int counterFds[PERF_N_COUNTERS] = {-1, -1, -1, -1};
+static int counterIndex[PERF_N_COUNTERS] = {-1, -1, -1, -1};
+
+static PerfKernel kernels[PERF_N_KERNELS];
+
+static int openCounter(uint32_t type, uint64_t config, int leader)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = leader == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    // Also count the threads started later (the OpenMP team of -j)
+    attr.inherit = 1;
+
+    // This process, any cpu
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+static void readCounters(uint64_t *values)
+{
+    // nr followed by one value per counter in the group
+    uint64_t buffer[1 + PERF_N_COUNTERS];
+
+    memset(values, 0, sizeof(uint64_t) * PERF_N_COUNTERS);
+
+    if (groupFd == -1 || read(groupFd, buffer, sizeof(buffer)) <= 0)
+    {
+        return;
+    }
+
+    for (int i = 0; i < PERF_N_COUNTERS; i++)
+    {
+        if (counterIndex[i] >= 0)
+        {
+            values[i] = buffer[1 + counterIndex[i]];
+        }
+    }
+}
+
+void perfInit(int enabled)
+{
+    uint32_t types[PERF_N_COUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+    uint64_t configs[PERF_N_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES};
+    int nOpen = 0;
+
+    perfEnabled = enabled;
+    memset(kernels, 0, sizeof(kernels));
+
+    if (!enabled)
+    {
+        return;
+    }
+
+    for (int i = 0; i < PERF_N_COUNTERS; i++)
+    {
+        int fd = openCounter(types[i], configs[i], groupFd);
+
+        if (fd == -1)
+        {
+            continue;
+        }
+
+        if (groupFd == -1)
+        {
+            groupFd = fd;
+        }
+
+        counterFds[i] = fd;
+        counterIndex[i] = nOpen++;
+    }
+
+    if (groupFd != -1)
+    {
+        ioctl(groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+void perfStart(int kernel)
+{
+    if (!perfEnabled)
+    {
+        return;
+    }
+
+    PerfKernel *k = &kernels[kernel];
+
+    if (k->depth++ > 0)
+    {
+        return;
+    }
+
+    readCounters(k->startCounts);
+    k->startTime = MPI_Wtime();
+}
+
+void perfStop(int kernel, double flops, double bytes)
+{
+    if (!perfEnabled)
+    {
+        return;
+    }
+
+    PerfKernel *k = &kernels[kernel];
+
+    if (--k->depth > 0)
+    {
+        return;
+    }
+
+    uint64_t counts[PERF_N_COUNTERS];
+
+    k->time += MPI_Wtime() - k->startTime;
+    readCounters(counts);
+
+    for (int i = 0; i < PERF_N_COUNTERS; i++)
+    {
+        k->counts[i] += (double)(counts[i] - k->startCounts[i]);
+    }
+
+    k->calls++;
+    k->flops += flops;
+    k->bytes += bytes;
+}
+
+/**
+ * Best flop rate of independent multiply-add chains that stay in
+ * registers and of a multiplication that fits in the cache: the
+ * compiler may vectorize the second one better
+ */
+static double measurePeak()
+{
+    double acc[8] = {1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0};
+    volatile double x = 0.999999, y = 1e-6;
+    double a = x, b = y;
+    double best = 0.0;
+
+    for (int r = 0; r < PERF_REPETITIONS; r++)
+    {
+        double ti = MPI_Wtime();
+
+        for (long i = 0; i < PERF_PEAK_ITERATIONS; i++)
+        {
+            for (int j = 0; j < 8; j++)
+            {
+                acc[j] = acc[j] * a + b;
+            }
+        }
+
+        double rate = 16.0 * PERF_PEAK_ITERATIONS / (MPI_Wtime() - ti);
+        if (rate > best)
+        {
+            best = rate;
+        }
+    }
+
+    // Keep the loop
+    x = acc[0] + acc[1] + acc[2] + acc[3] + acc[4] + acc[5] + acc[6] + acc[7];
+
+    long size = PLANNER_BLOCK_SIZE;
+    Matrix *m = createMatrix(size, size);
+    Matrix *c = createMatrixFilledWithZeros(size, size);
+
+    fillMatrixWithRandom(m);
+
+    for (int r = 0; r < PERF_REPETITIONS; r++)
+    {
+        double ti = MPI_Wtime();
+
+        multiplyMatrixAndSumBlock(m, m, c, 0, 0, 0, 0, 0, 0, size, size, size);
+
+        double rate = 2.0 * size * size * size / (MPI_Wtime() - ti);
+        if (rate > best)
+        {
+            best = rate;
+        }
+    }
+
+    destroyMatrix(m);
+    destroyMatrix(c);
+
+    return best;
+}
+
+/**
+ * Bytes per second of a triad on arrays that don't fit in the cache
+ */
+static double measureBandwidth()
+{
+    long n = PERF_BANDWIDTH_SIZE;
+    double *a = (double *)malloc(sizeof(double) * n);
+    double *b = (double *)malloc(sizeof(double) * n);
+    double *c = (double *)malloc(sizeof(double) * n);
+    double best = 0.0;
+
+    fillArrayWithZeros(a, n);
+    fillArrayWithRandom(b, n);
+    fillArrayWithRandom(c, n);
+
+    for (int r = 0; r < PERF_REPETITIONS; r++)
+    {
+        double ti = MPI_Wtime();
+
+        for (long i = 0; i < n; i++)
+        {
+            a[i] = b[i] + 0.5 * c[i];
+        }
+
+        double rate = 3.0 * sizeof(double) * n / (MPI_Wtime() - ti);
+        if (rate > best)
+        {
+            best = rate;
+        }
+    }
+
+    free(a);
+    free(b);
+    free(c);
+
+    return best;
+}
+
+/**
+ * Prints the line of one kernel. values: calls, time, flops, bytes and
+ * the counters.
+ */
+static void printKernel(const char *name, const double *values, const double *available, double peak, double bandwidth)
+{
+    double calls = values[0], time = values[1], flops = values[2], bytes = values[3];
+    const double *counts = values + 4;
+    char ipc[16] = "-", l1[16] = "-", llc[16] = "-";
+
+    if (calls == 0 || time <= 0.0)
+    {
+        return;
+    }
+
+    if (available[0] && available[1] && counts[0] > 0)
+    {
+        snprintf(ipc, sizeof(ipc), "%.2f", counts[1] / counts[0]);
+    }
+
+    if (available[2])
+    {
+        snprintf(l1, sizeof(l1), "%.3g", counts[2] * 1000.0 / flops);
+    }
+
+    // The compulsory traffic is a lower bound: the prefetches don't
+    // count as misses
+    if (available[3])
+    {
+        snprintf(llc, sizeof(llc), "%.3g", counts[3] * 1000.0 / flops);
+
+        if (counts[3] * CACHE_LINE_SIZE > bytes)
+        {
+            bytes = counts[3] * CACHE_LINE_SIZE;
+        }
+    }
+
+    double gflops = flops / time / 1e9;
+    double intensity = flops / bytes;
+    double roof = fmin(peak, intensity * bandwidth) / 1e9;
+
+    printf("  %-9s %9.0f %10.4f %8.3f %6s %10s %10s %8.3f %8.3f %6.1f%%  %s\n",
+           name,
+           calls,
+           time,
+           gflops,
+           ipc,
+           l1,
+           llc,
+           intensity,
+           roof,
+           100.0 * gflops / roof,
+           intensity < peak / bandwidth ? "memory" : "compute");
+}
+
+void perfReport(int myrank, int npes, MPI_Comm comm)
+{
+    if (!perfEnabled)
+    {
+        return;
+    }
+
+    // peak, bandwidth, counter availability, then the kernels
+    const int kernelLength = 4 + PERF_N_COUNTERS;
+    const int length = 2 + PERF_N_COUNTERS + PERF_N_KERNELS * kernelLength;
+
+    double *values = (double *)malloc(sizeof(double) * length);
+    double *all = NULL;
+
+    values[0] = measurePeak();
+    values[1] = measureBandwidth();
+
+    for (int i = 0; i < PERF_N_COUNTERS; i++)
+    {
+        values[2 + i] = counterIndex[i] >= 0;
+    }
+
+    for (int k = 0; k < PERF_N_KERNELS; k++)
+    {
+        double *v = values + 2 + PERF_N_COUNTERS + k * kernelLength;
+
+        v[0] = kernels[k].calls;
+        v[1] = kernels[k].time;
+        v[2] = kernels[k].flops;
+        v[3] = kernels[k].bytes;
+        memcpy(v + 4, kernels[k].counts, sizeof(double) * PERF_N_COUNTERS);
+    }
+
+    if (myrank == 0)
+    {
+        all = (double *)malloc(sizeof(double) * length * npes);
+    }
+
+    MPI_Gather(values, length, MPI_DOUBLE, all, length, MPI_DOUBLE, 0, comm);
+
+    if (myrank == 0)
+    {
+        for (int p = 0; p < npes; p++)
+        {
+            double *v = all + p * length;
+            double peak = v[0], bandwidth = v[1];
+
+            printf("Rank %d: peak %.3f GFLOP/s, bandwidth %.3f GB/s, ridge %.3f flop/byte%s\n",
+                   p,
+                   peak / 1e9,
+                   bandwidth / 1e9,
+                   peak / bandwidth,
+                   v[2] || v[3] || v[4] || v[5] ? "" : " (no hardware counters)");
+            printf("  %-9s %9s %10s %8s %6s %10s %10s %8s %8s %7s  %s\n",
+                   "kernel",
+                   "calls",
+                   "time(s)",
+                   "GFLOP/s",
+                   "IPC",
+                   "L1D/kflop",
+                   "LLC/kflop",
+                   "flop/B",
+                   "roof",
+                   "%roof",
+                   "bound");
+
+            for (int k = 0; k < PERF_N_KERNELS; k++)
+            {
+                printKernel(kernelNames[k], v + 2 + PERF_N_COUNTERS + k * kernelLength, v + 2, peak, bandwidth);
+            }
+        }
+
+        free(all);
+    }
+
+    free(values);
+
+    for (int i = 0; i < PERF_N_COUNTERS; i++)
+    {
+        if (counterFds[i] != -1)
+        {
+            close(counterFds[i]);
+        }
+        counterFds[i] = -1;
+        counterIndex[i] = -1;
+    }
+    groupFd = -1;
+    perfEnabled = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <mpi.h>
+
+#include "util.h"
+
+/**
+ * Optional instrumentation (-p) of the matrix kernels with the
+ * perf_event_open hardware counters.
+ *
+ * Each kernel call is wrapped with perfStart / perfStop. Nested calls
+ * (the Strassen recursion) are only counted once, by the outermost one.
+ * The floating point operations and the compulsory memory traffic come
+ * from the kernel dimensions: there is no portable FP ops event.
+ * If the kernel doesn't let us open the counters (perf_event_paranoid,
+ * containers) only the times, GFLOP/s and modelled traffic are reported.
+ * The roof uses the memory bandwidth, so kernels whose data stays in the
+ * cache can go over 100%.
+ * The counters are inherited by the threads created after perfInit, so
+ * with -j they count the whole OpenMP team (and the background writer
+ * of -W while it overlaps a kernel).
+ */
+
+/**
+ * Opens the counters if enabled, otherwise perfStart / perfStop do nothing
+ */
+void perfInit(int enabled);
+
+void perfStart(int kernel);
+
+/**
+ * Ends a kernel call with flops floating point operations that must
+ * move at least bytes between the memory and the processor
+ */
+void perfStop(int kernel, double flops, double bytes);
+
+/**
+ * Measures the peak flop rate and memory bandwidth of each process and
+ * prints, on process #0, the counters, GFLOP/s, arithmetic intensity and
+ * roofline position of each kernel and process. Closes the counters.
+ * Must be called by every process of comm.
+ */
+void perfReport(int myrank, int npes, MPI_Comm comm);
+
+#endif
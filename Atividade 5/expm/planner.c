@@ -0,0 +1,246 @@
+#include "planner.h"
+
+CostModel calibrateCostModel(int myrank, int npes, MPI_Comm comm)
+{
+    CostModel model;
+    double ti;
+
+    // gamma: one multiplication that fits in cache
+    long size = PLANNER_BLOCK_SIZE;
+    Matrix *a = createMatrix(size, size);
+    Matrix *c = createMatrixFilledWithZeros(size, size);
+
+    fillMatrixWithRandom(a);
+
+    ti = MPI_Wtime();
+    multiplyMatrixAndSumBlock(a, a, c, 0, 0, 0, 0, 0, 0, size, size, size);
+    model.gamma = (MPI_Wtime() - ti) / (2.0 * size * size * size);
+
+    destroyMatrix(a);
+    destroyMatrix(c);
+
+    // The slowest process sets the pace
+    MPI_Allreduce(MPI_IN_PLACE, &model.gamma, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    // alpha and beta: ping-pong between #0 and #1
+    model.alpha = 0.0;
+    model.beta = 0.0;
+
+    if (npes > 1)
+    {
+        long length = PLANNER_MESSAGE_SIZE;
+        double *buffer = (double *)malloc(sizeof(double) * length);
+        double times[2] = {0.0, 0.0};
+        long lengths[2] = {1, length};
+
+        fillArrayWithZeros(buffer, length);
+
+        for (int i = 0; i < 2; i++)
+        {
+            MPI_Barrier(comm);
+            ti = MPI_Wtime();
+
+            for (int r = 0; r < PLANNER_REPETITIONS && myrank < 2; r++)
+            {
+                if (myrank == 0)
+                {
+                    MPI_Send(buffer, lengths[i], MPI_DOUBLE, 1, MESSAGE_TAG_PLANNER, comm);
+                    MPI_Recv(buffer, lengths[i], MPI_DOUBLE, 1, MESSAGE_TAG_PLANNER, comm, MPI_STATUS_IGNORE);
+                }
+                else
+                {
+                    MPI_Recv(buffer, lengths[i], MPI_DOUBLE, 0, MESSAGE_TAG_PLANNER, comm, MPI_STATUS_IGNORE);
+                    MPI_Send(buffer, lengths[i], MPI_DOUBLE, 0, MESSAGE_TAG_PLANNER, comm);
+                }
+            }
+
+            // One way time
+            times[i] = (MPI_Wtime() - ti) / (2.0 * PLANNER_REPETITIONS);
+        }
+
+        model.alpha = times[0];
+        model.beta = (times[1] - times[0]) / (sizeof(double) * (length - 1));
+        if (model.beta < 0.0)
+        {
+            model.beta = 0.0;
+        }
+
+        free(buffer);
+    }
+
+    MPI_Bcast(&model.alpha, 1, MPI_DOUBLE, 0, comm);
+    MPI_Bcast(&model.beta, 1, MPI_DOUBLE, 0, comm);
+
+    // Number of nodes: number of shared memory node leaders
+    MPI_Comm nodeComm;
+    int nodeRank = 0;
+
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, myrank, MPI_INFO_NULL, &nodeComm);
+    MPI_Comm_rank(nodeComm, &nodeRank);
+    MPI_Comm_free(&nodeComm);
+
+    model.nNodes = nodeRank == 0 ? 1 : 0;
+    MPI_Allreduce(MPI_IN_PLACE, &model.nNodes, 1, MPI_INT, MPI_SUM, comm);
+
+    return model;
+}
+
+double predictTermTime(const CostModel *model, long n, int npes, int transport)
+{
+    double nColumns = calculateColumnsPerProcess(n, npes);
+    double nRows = nColumns / npes;
+
+    // Whole term on one process
+    if (npes == 1)
+    {
+        return 2.0 * nColumns * nColumns * nColumns * model->gamma;
+    }
+
+    // Max reduction + go / no go broadcast
+    double collectives = 2.0 * model->alpha * ceil(log2(npes));
+
+    if (transport == TRANSPORT_SHM)
+    {
+        double compute = 2.0 * nRows * nColumns * nColumns * model->gamma;
+
+        // Only the node leaders exchange blocks
+        double exchange = 0.0;
+        if (model->nNodes > 1)
+        {
+            exchange = (model->nNodes - 1) *
+                       (model->alpha + model->beta * sizeof(double) * nColumns * nColumns / model->nNodes);
+        }
+
+        // Node barriers
+        return compute + exchange + 3.0 * model->alpha + collectives;
+    }
+
+    // Ring (and rma): one block multiply per step, overlapped with
+    // receiving the next block
+    double step = 2.0 * nRows * nRows * nColumns * model->gamma;
+    double message = model->alpha + model->beta * sizeof(double) * nRows * nColumns;
+
+    return (npes - 1) * fmax(step, message) + step + collectives;
+}
+
+/**
+ * Estimates the number of terms from the growth of ||A^j x||, which
+ * approaches the spectral radius of A
+ */
+static long estimateTerms(const Matrix *a, double tolerance)
+{
+    long n = a->nRows;
+    double *x = (double *)malloc(sizeof(double) * n);
+    double *y = (double *)malloc(sizeof(double) * n);
+    double *tmp;
+    double logGrowth = 0.0;
+
+    for (long i = 0; i < n; i++)
+    {
+        x[i] = 1.0 / sqrt(n);
+    }
+
+    for (int j = 0; j < PLANNER_POWER_ITERATIONS; j++)
+    {
+        double norm = 0.0;
+
+        for (long i = 0; i < n; i++)
+        {
+            y[i] = 0.0;
+            for (long l = 0; l < n; l++)
+            {
+                y[i] += a->data[i * n + l] * x[l];
+            }
+            norm += y[i] * y[i];
+        }
+
+        norm = sqrt(norm);
+        if (norm == 0.0)
+        {
+            break;
+        }
+
+        logGrowth += log(norm);
+
+        for (long i = 0; i < n; i++)
+        {
+            y[i] /= norm;
+        }
+
+        tmp = x;
+        x = y;
+        y = tmp;
+    }
+
+    free(x);
+    free(y);
+
+    return termsForTolerance(exp(logGrowth / PLANNER_POWER_ITERATIONS), tolerance);
+}
+
+Plan makePlan(const ParsedParams *params, const Matrix *globalA, int myrank, int npes, MPI_Comm comm)
+{
+    Plan plan;
+    CostModel model = calibrateCostModel(myrank, npes, comm);
+
+    // The transport given with -c is kept, and -l and -z only work with
+    // the ring
+    int transports[2] = {TRANSPORT_RING, TRANSPORT_SHM};
+    int nTransports = 2;
+
+    if (params->transportChosen)
+    {
+        transports[0] = params->transport;
+        nTransports = 1;
+    }
+    else if (params->adaptive || params->compression != COMPRESSION_NONE)
+    {
+        nTransports = 1;
+    }
+
+    plan.npes = 1;
+    plan.transport = transports[0];
+    plan.nTerms = 0;
+    plan.predictedTime = predictTermTime(&model, params->n, 1, TRANSPORT_RING);
+
+    if (myrank == 0)
+    {
+        plan.nTerms = estimateTerms(globalA, params->tolerance);
+    }
+
+    MPI_Bcast(&plan.nTerms, 1, MPI_LONG, 0, comm);
+
+    for (int p = 2; p <= npes && p <= params->n; p++)
+    {
+        for (int i = 0; i < nTransports; i++)
+        {
+            double time = predictTermTime(&model, params->n, p, transports[i]);
+
+            if (time < plan.predictedTime)
+            {
+                plan.npes = p;
+                plan.transport = transports[i];
+                plan.predictedTime = time;
+            }
+        }
+    }
+
+    plan.predictedTime *= plan.nTerms;
+
+    if (myrank == 0)
+    {
+        printf("Cost model: alpha %es, beta %es/B, gamma %es/flop, %d node(s)\n",
+               model.alpha,
+               model.beta,
+               model.gamma,
+               model.nNodes);
+
+        printf("Plan: %d process(es), %s transport, ~%ld terms, predicted time %fs\n",
+               plan.npes,
+               plan.transport == TRANSPORT_SHM ? "shm" : plan.transport == TRANSPORT_RMA ? "rma" : "ring",
+               plan.nTerms,
+               plan.predictedTime);
+    }
+
+    return plan;
+}
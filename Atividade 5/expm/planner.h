@@ -0,0 +1,56 @@
+#ifndef __PLANNER_H__
+#define __PLANNER_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <mpi.h>
+
+#include "matrix.h"
+#include "parse_param.h"
+#include "multi_process.h"
+
+/**
+ * Cost model of this machine:
+ * alpha: seconds per message (latency)
+ * beta: seconds per byte sent
+ * gamma: seconds per floating point operation of the multiply
+ */
+typedef struct cost_model
+{
+    double alpha;
+    double beta;
+    double gamma;
+    int nNodes;
+} CostModel;
+
+/**
+ * What to run
+ */
+typedef struct plan
+{
+    int npes;
+    int transport;
+    long nTerms;
+    double predictedTime;
+} Plan;
+
+/**
+ * Measures the cost model. Must be called by every process.
+ */
+CostModel calibrateCostModel(int myrank, int npes, MPI_Comm comm);
+
+/**
+ * Predicted time for one term of the Taylor series
+ */
+double predictTermTime(const CostModel *model, long n, int npes, int transport);
+
+/**
+ * Chooses the number of processes and the transport for params->n.
+ * A transport given with -c is kept, and -l and -z keep the ring.
+ * globalA is only used on process #0 to estimate the number of terms.
+ * Every process gets the same plan.
+ */
+Plan makePlan(const ParsedParams *params, const Matrix *globalA, int myrank, int npes, MPI_Comm comm);
+
+#endif
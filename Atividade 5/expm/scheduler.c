@@ -0,0 +1,327 @@
+#include "scheduler.h"
+
+TaskGraph *createTaskGraph()
+{
+    TaskGraph *g = (TaskGraph *)malloc(sizeof(TaskGraph));
+
+    g->readyCapacity = 64;
+    g->ready = (Task **)malloc(sizeof(Task *) * g->readyCapacity);
+    g->readyHead = 0;
+    g->nReady = 0;
+
+    g->nWaiting = 0;
+
+    g->pendingCapacity = 0;
+    g->nFree = 0;
+    g->pending = NULL;
+    g->owners = NULL;
+    g->completed = NULL;
+    g->freeSlots = NULL;
+
+    g->tasks = NULL;
+    g->nTasks = 0;
+
+    return g;
+}
+
+void destroyTaskGraph(TaskGraph *g)
+{
+    if (g == NULL)
+    {
+        return;
+    }
+
+    while (g->tasks != NULL)
+    {
+        Task *next = g->tasks->next;
+
+        free(g->tasks->successors);
+        free(g->tasks->requests);
+        free(g->tasks);
+
+        g->tasks = next;
+    }
+
+    free(g->ready);
+    free(g->pending);
+    free(g->owners);
+    free(g->completed);
+    free(g->freeSlots);
+    free(g);
+}
+
+Task *addTask(TaskGraph *g,
+              Task **handle,
+              TaskFunction run,
+              TaskFunction done,
+              void *context,
+              long k,
+              long index,
+              int maxRequests)
+{
+    Task *task = (Task *)malloc(sizeof(Task));
+
+    task->run = run;
+    task->done = done;
+    task->context = context;
+    task->k = k;
+    task->index = index;
+
+    task->nDependencies = 0;
+    task->submitted = 0;
+    task->finished = 0;
+
+    task->successors = NULL;
+    task->nSuccessors = 0;
+    task->successorCapacity = 0;
+
+    task->maxRequests = maxRequests;
+    task->nRequests = 0;
+    task->nPending = 0;
+    task->requests = maxRequests > 0 ? (MPI_Request *)malloc(sizeof(MPI_Request) * maxRequests) : NULL;
+
+    task->handle = handle;
+    if (handle != NULL)
+    {
+        *handle = task;
+    }
+
+    task->previous = NULL;
+    task->next = g->tasks;
+    if (g->tasks != NULL)
+    {
+        g->tasks->previous = task;
+    }
+    g->tasks = task;
+    g->nTasks++;
+
+    return task;
+}
+
+void addDependency(Task *before, Task *after)
+{
+    if (before == NULL || before->finished)
+    {
+        return;
+    }
+
+    if (before->nSuccessors == before->successorCapacity)
+    {
+        before->successorCapacity = before->successorCapacity > 0 ? 2 * before->successorCapacity : 4;
+        before->successors = (Task **)realloc(before->successors, sizeof(Task *) * before->successorCapacity);
+    }
+
+    before->successors[before->nSuccessors++] = after;
+    after->nDependencies++;
+}
+
+static void pushReady(TaskGraph *g, Task *task)
+{
+    if (g->nReady == g->readyCapacity)
+    {
+        Task **ready = (Task **)malloc(sizeof(Task *) * 2 * g->readyCapacity);
+
+        for (long i = 0; i < g->nReady; i++)
+        {
+            ready[i] = g->ready[(g->readyHead + i) % g->readyCapacity];
+        }
+
+        free(g->ready);
+        g->ready = ready;
+        g->readyHead = 0;
+        g->readyCapacity *= 2;
+    }
+
+    g->ready[(g->readyHead + g->nReady) % g->readyCapacity] = task;
+    g->nReady++;
+}
+
+static Task *popReady(TaskGraph *g)
+{
+    Task *task = g->ready[g->readyHead];
+
+    g->readyHead = (g->readyHead + 1) % g->readyCapacity;
+    g->nReady--;
+
+    return task;
+}
+
+void submitTask(TaskGraph *g, Task *task)
+{
+    task->submitted = 1;
+
+    if (task->nDependencies == 0)
+    {
+        pushReady(g, task);
+    }
+}
+
+/**
+ * Releases the successors of a task whose work (and requests) is done,
+ * and frees it
+ */
+static void finishTask(TaskGraph *g, Task *task)
+{
+    task->finished = 1;
+
+    if (task->done != NULL)
+    {
+        task->done(g, task);
+    }
+
+    for (int i = 0; i < task->nSuccessors; i++)
+    {
+        Task *successor = task->successors[i];
+
+        successor->nDependencies--;
+
+        if (successor->nDependencies == 0 && successor->submitted)
+        {
+            pushReady(g, successor);
+        }
+    }
+
+    // Nothing refers to it any more
+    if (task->handle != NULL)
+    {
+        *task->handle = NULL;
+    }
+
+    if (task->previous != NULL)
+    {
+        task->previous->next = task->next;
+    }
+    else
+    {
+        g->tasks = task->next;
+    }
+
+    if (task->next != NULL)
+    {
+        task->next->previous = task->previous;
+    }
+
+    free(task->successors);
+    free(task->requests);
+    free(task);
+}
+
+/**
+ * Moves the requests started by a task to free slots of the pending
+ * requests, which grow when they are all taken
+ */
+static void waitForRequests(TaskGraph *g, Task *task)
+{
+    if (g->nFree < task->nRequests)
+    {
+        int capacity = g->pendingCapacity > 0 ? 2 * g->pendingCapacity : 64;
+
+        while (capacity - g->pendingCapacity + g->nFree < task->nRequests)
+        {
+            capacity *= 2;
+        }
+
+        g->pending = (MPI_Request *)realloc(g->pending, sizeof(MPI_Request) * capacity);
+        g->owners = (Task **)realloc(g->owners, sizeof(Task *) * capacity);
+        g->completed = (int *)realloc(g->completed, sizeof(int) * capacity);
+        g->freeSlots = (int *)realloc(g->freeSlots, sizeof(int) * capacity);
+
+        for (int slot = capacity - 1; slot >= g->pendingCapacity; slot--)
+        {
+            g->pending[slot] = MPI_REQUEST_NULL;
+            g->owners[slot] = NULL;
+            g->freeSlots[g->nFree++] = slot;
+        }
+
+        g->pendingCapacity = capacity;
+    }
+
+    for (int i = 0; i < task->nRequests; i++)
+    {
+        int slot = g->freeSlots[--g->nFree];
+
+        g->pending[slot] = task->requests[i];
+        g->owners[slot] = task;
+    }
+
+    task->nPending = task->nRequests;
+    g->nWaiting++;
+}
+
+/**
+ * Progresses the requests in flight, blocking until at least one of
+ * them completes if wait is set, and finishes the waiting tasks whose
+ * requests have all completed. A single MPI_Testsome / MPI_Waitsome for
+ * all of them.
+ */
+static void progressRequests(TaskGraph *g, int wait)
+{
+    int nCompleted = 0;
+
+    if (wait)
+    {
+        MPI_Waitsome(g->pendingCapacity, g->pending, &nCompleted, g->completed, MPI_STATUSES_IGNORE);
+    }
+    else
+    {
+        MPI_Testsome(g->pendingCapacity, g->pending, &nCompleted, g->completed, MPI_STATUSES_IGNORE);
+    }
+
+    if (nCompleted == MPI_UNDEFINED)
+    {
+        return;
+    }
+
+    // The completed requests are now MPI_REQUEST_NULL: their slots are
+    // free again
+    for (int i = 0; i < nCompleted; i++)
+    {
+        int slot = g->completed[i];
+        Task *task = g->owners[slot];
+
+        g->owners[slot] = NULL;
+        g->freeSlots[g->nFree++] = slot;
+
+        if (--task->nPending == 0)
+        {
+            g->nWaiting--;
+            finishTask(g, task);
+        }
+    }
+}
+
+int runTaskGraph(TaskGraph *g)
+{
+    while (g->nReady > 0 || g->nWaiting > 0)
+    {
+        if (g->nReady > 0)
+        {
+            Task *task = popReady(g);
+
+            task->nRequests = 0;
+            task->run(g, task);
+
+            if (task->nRequests > 0)
+            {
+                waitForRequests(g, task);
+            }
+            else
+            {
+                finishTask(g, task);
+            }
+
+            // Progress the communications between the tasks
+            if (g->nWaiting > 0)
+            {
+                progressRequests(g, 0);
+            }
+        }
+        else
+        {
+            // Nothing to do until a request completes
+            progressRequests(g, 1);
+        }
+    }
+
+    return OK;
+}
@@ -0,0 +1,136 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <mpi.h>
+
+#include "util.h"
+
+/**
+ * Dependency driven task scheduler (-G).
+ *
+ * A task runs once every task it depends on has finished. Its function
+ * may start MPI requests (task->requests): the task then finishes when
+ * they complete, and until then the scheduler runs other ready tasks.
+ * When nothing is ready it waits for any of the requests in flight, so
+ * a task never blocks the ones that could let the others progress.
+ *
+ * Tasks may add new tasks while they run or finish. The ready tasks run
+ * in the order they became ready. A task is freed as soon as it has
+ * finished.
+ */
+typedef struct task Task;
+typedef struct task_graph TaskGraph;
+
+typedef void (*TaskFunction)(TaskGraph *g, Task *task);
+
+struct task
+{
+    /**
+     * Called when the task is ready and, if not NULL, when it finishes
+     */
+    TaskFunction run;
+    TaskFunction done;
+
+    /**
+     * Arguments of the functions
+     */
+    void *context;
+    long k;
+    long index;
+
+    /**
+     * Number of dependencies that haven't finished. The task is only
+     * queued after submitTask.
+     */
+    int nDependencies;
+    int submitted;
+    int finished;
+
+    Task **successors;
+    int nSuccessors;
+    int successorCapacity;
+
+    /**
+     * Requests started by run (up to maxRequests) and how many of them
+     * are still in flight
+     */
+    MPI_Request *requests;
+    int nRequests;
+    int maxRequests;
+    int nPending;
+
+    /**
+     * Where the caller keeps the task, set to NULL when it is freed
+     */
+    Task **handle;
+
+    // Tasks that haven't finished yet, freed with the graph
+    Task *previous;
+    Task *next;
+};
+
+struct task_graph
+{
+    /**
+     * Ready tasks (circular queue)
+     */
+    Task **ready;
+    long readyHead;
+    long nReady;
+    long readyCapacity;
+
+    /**
+     * Number of tasks waiting for their requests
+     */
+    long nWaiting;
+
+    /**
+     * Requests in flight, with the task of each one, for MPI_Testsome /
+     * MPI_Waitsome. The free slots are MPI_REQUEST_NULL and their
+     * indices are kept in freeSlots.
+     */
+    MPI_Request *pending;
+    Task **owners;
+    int *completed;
+    int *freeSlots;
+    int nFree;
+    int pendingCapacity;
+
+    Task *tasks;
+    long nTasks;
+};
+
+TaskGraph *createTaskGraph();
+
+void destroyTaskGraph(TaskGraph *g);
+
+/**
+ * New task with room for maxRequests requests, also stored in *handle
+ * (if not NULL) until it is freed. It isn't queued until submitTask is
+ * called: add its dependencies first.
+ */
+Task *addTask(TaskGraph *g,
+              Task **handle,
+              TaskFunction run,
+              TaskFunction done,
+              void *context,
+              long k,
+              long index,
+              int maxRequests);
+
+/**
+ * after runs once before has finished. Does nothing if before has
+ * already finished (and been freed: NULL).
+ */
+void addDependency(Task *before, Task *after);
+
+void submitTask(TaskGraph *g, Task *task);
+
+/**
+ * Runs the tasks until there are none left
+ */
+int runTaskGraph(TaskGraph *g);
+
+#endif
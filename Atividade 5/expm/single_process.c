@@ -1,7 +1,29 @@
 #include "single_process.h"
 
-int singleProcess(const ParsedParams *params, const Matrix *a, Matrix *s)
+int singleProcess(const ParsedParams *params, const Matrix *a, Matrix **s)
 {
+    /**
+     * Number of terms from the a-priori bound, using the smallest of
+     * the infinity norm and the 1-norm of A
+     */
+    long nTerms = 0;
+
+    if (params->aPriori)
+    {
+        double norm = fmin(maxRowSum(a), maxColumnSum(a)) * maxAbsTime(params);
+
+        nTerms = termsForTolerance(norm, params->tolerance);
+        printf("A-priori bound: %ld terms\n", nTerms);
+    }
+
+    // Small matrices have their own kernels and don't need any buffers.
+    // The Strassen recursion only runs for blocks of at least the cutoff.
+    if (hasSmallKernel(params->n) == OK && params->nTimes == 1 && params->times[0] == 1.0 &&
+        (params->strassenCutoff <= 0 || params->strassenCutoff > params->n))
+    {
+        return smallTaylor(params->n, a->data, s[0]->data, params->tolerance, nTerms, params->finalCheck);
+    }
+
     /**
      * M_k matrix
      */
@@ -15,7 +37,23 @@ int singleProcess(const ParsedParams *params, const Matrix *a, Matrix *s)
 
     long d = params->n * params->n;
 
-    double *zeroes = (double *)malloc(sizeof(double) * d);
+    /**
+     * Strassen-Winograd is less accurate than the classic multiplication:
+     * only use it if the error on A * A is within the tolerance
+     */
+    long strassenCutoff = params->strassenCutoff;
+
+    if (strassenCutoff > 0)
+    {
+        double error = strassenError(a, strassenCutoff);
+        if (error > params->tolerance)
+        {
+            printf("[WARNING] Strassen error %e is above the tolerance. Disabled.\n", error);
+            strassenCutoff = 0;
+        }
+    }
+
+    double *zeroes = (double *)allocateTracked(sizeof(double) * d, MEMORY_ZEROES);
     fillArrayWithZeros(zeroes, d);
 
     /**
@@ -23,32 +61,58 @@ int singleProcess(const ParsedParams *params, const Matrix *a, Matrix *s)
      */
     double *tmp;
 
+    /**
+     * t^k for each t
+     */
+    double *powers = (double *)malloc(sizeof(double) * params->nTimes);
+
+    /**
+     * Largest t^k: the stop condition is scale * M_k <= tolerance
+     */
+    double scale;
+
     // M1 = A
     m = duplicateMatrix(a);
 
-    // S1 = I + M1
-    setIdentityMatrix(s);
-    sumMatrix(m, s);
+    // S1 = I + t M1
+    for (int i = 0; i < params->nTimes; i++)
+    {
+        setIdentityMatrix(s[i]);
+        powers[i] = 1.0;
+    }
+    scale = sumTaylorTerm(m, s, params->times, powers, params->nTimes);
 
     long k = 2;
+
+    /**
+     * Live metrics (-M)
+     */
+    Metrics *metrics = NULL;
+
+    if (params->metricsFile != NULL)
+    {
+        metrics = createMetrics(params->metricsFile, params->n, 1, params->tolerance, 0);
+    }
+
     do
     {
         // reset multiplied
         memcpy(multiplied->data, zeroes, sizeof(double) * d);
 
         // M_k = A * M_k-1 / k
-        multiplyMatrixAndSumBlock(a,
-                                  m,
-                                  multiplied,
-                                  0,
-                                  0,
-                                  0,
-                                  0,
-                                  0,
-                                  0,
-                                  a->nRows,
-                                  m->nRows,
-                                  m->nColumns);
+        multiplyMatrixAndSumStrassen(a,
+                                     m,
+                                     multiplied,
+                                     0,
+                                     0,
+                                     0,
+                                     0,
+                                     0,
+                                     0,
+                                     a->nRows,
+                                     m->nRows,
+                                     m->nColumns,
+                                     strassenCutoff);
 
         tmp = multiplied->data;
         multiplied->data = m->data;
@@ -56,14 +120,23 @@ int singleProcess(const ParsedParams *params, const Matrix *a, Matrix *s)
 
         divideMatrixByLong(m, k);
 
-        // S_k = S_k-1 + M_k
-        sumMatrix(m, s);
+        // S_k = S_k-1 + t^k M_k
+        scale = sumTaylorTerm(m, s, params->times, powers, params->nTimes);
+
+        if (metrics != NULL)
+        {
+            updateMetrics(metrics, k, maxMij(m) * scale, 0.0, NULL, nTerms);
+        }
 
         k++;
-    } while (maxMij(m) > params->tolerance);
+    } while ((params->aPriori && k <= nTerms) ||
+             ((!params->aPriori || params->finalCheck) && maxMij(m) * scale > params->tolerance));
 
+    destroyMetrics(metrics);
     destroyMatrix(m);
     destroyMatrix(multiplied);
+    freeTracked(zeroes);
+    free(powers);
 
     return OK;
 }
@@ -5,8 +5,14 @@
 #include <stdio.h>
 
 #include "matrix.h"
+#include "memory.h"
 #include "parse_param.h"
+#include "small_matrix.h"
+#include "metrics.h"
 
-int singleProcess(const ParsedParams *params, const Matrix *a, Matrix *s);
+/**
+ * Calculates s[i] = exp(t_i a) for each params->times[i]
+ */
+int singleProcess(const ParsedParams *params, const Matrix *a, Matrix **s);
 
 #endif
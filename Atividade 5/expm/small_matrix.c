@@ -0,0 +1,111 @@
+#include "small_matrix.h"
+
+/**
+ * Generates the Taylor series kernel for N x N matrices.
+ * Each step does M_k = A * M_k-1 / k, S_k = S_k-1 + M_k and the
+ * max |M_k(i,j)| in a single pass.
+ */
+#define SMALL_TAYLOR(N)                                                  \
+    static int smallTaylor##N(const double *a,                           \
+                              double *s,                                 \
+                              double tolerance,                          \
+                              long nTerms,                               \
+                              int finalCheck)                            \
+    {                                                                    \
+        double buffers[2][N * N];                                        \
+        double *m = buffers[0];                                          \
+        double *next = buffers[1];                                       \
+        double *tmp;                                                     \
+        double val, max;                                                 \
+        long k = 2;                                                      \
+                                                                         \
+        /* M1 = A, S1 = I + M1 */                                        \
+        for (int i = 0; i < N * N; i++)                                  \
+        {                                                                \
+            m[i] = a[i];                                                 \
+            s[i] = a[i] + (i % (N + 1) == 0 ? 1.0 : 0.0);                \
+        }                                                                \
+                                                                         \
+        do                                                               \
+        {                                                                \
+            max = 0.0;                                                   \
+                                                                         \
+            for (int i = 0; i < N; i++)                                  \
+            {                                                            \
+                for (int j = 0; j < N; j++)                              \
+                {                                                        \
+                    val = 0.0;                                           \
+                    for (int l = 0; l < N; l++)                          \
+                    {                                                    \
+                        val += a[i * N + l] * m[l * N + j];              \
+                    }                                                    \
+                                                                         \
+                    val /= k;                                            \
+                    next[i * N + j] = val;                               \
+                    s[i * N + j] += val;                                 \
+                                                                         \
+                    if (fabs(val) > max)                                 \
+                    {                                                    \
+                        max = fabs(val);                                 \
+                    }                                                    \
+                }                                                        \
+            }                                                            \
+                                                                         \
+            tmp = m;                                                     \
+            m = next;                                                    \
+            next = tmp;                                                  \
+                                                                         \
+            k++;                                                         \
+        } while ((nTerms > 0 && k <= nTerms) ||                          \
+                 ((nTerms == 0 || finalCheck) && max > tolerance));      \
+                                                                         \
+        return OK;                                                       \
+    }
+
+SMALL_TAYLOR(2)
+SMALL_TAYLOR(3)
+SMALL_TAYLOR(4)
+SMALL_TAYLOR(6)
+SMALL_TAYLOR(8)
+SMALL_TAYLOR(16)
+SMALL_TAYLOR(32)
+
+int hasSmallKernel(long n)
+{
+    switch (n)
+    {
+    case 2:
+    case 3:
+    case 4:
+    case 6:
+    case 8:
+    case 16:
+    case 32:
+        return OK;
+    }
+
+    return NOK;
+}
+
+int smallTaylor(long n, const double *a, double *s, double tolerance, long nTerms, int finalCheck)
+{
+    switch (n)
+    {
+    case 2:
+        return smallTaylor2(a, s, tolerance, nTerms, finalCheck);
+    case 3:
+        return smallTaylor3(a, s, tolerance, nTerms, finalCheck);
+    case 4:
+        return smallTaylor4(a, s, tolerance, nTerms, finalCheck);
+    case 6:
+        return smallTaylor6(a, s, tolerance, nTerms, finalCheck);
+    case 8:
+        return smallTaylor8(a, s, tolerance, nTerms, finalCheck);
+    case 16:
+        return smallTaylor16(a, s, tolerance, nTerms, finalCheck);
+    case 32:
+        return smallTaylor32(a, s, tolerance, nTerms, finalCheck);
+    }
+
+    return NOK;
+}
@@ -0,0 +1,27 @@
+#ifndef __SMALL_MATRIX_H__
+#define __SMALL_MATRIX_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "util.h"
+
+/**
+ * Returns OK if there is a specialized kernel for n x n matrices
+ */
+int hasSmallKernel(long n);
+
+/**
+ * Calculates s = exp(a) for small n x n matrices using the kernel
+ * specialized for n. The loops have fixed bounds, so the compiler can
+ * unroll them and keep the matrices in registers / on the stack.
+ * Stops like singleProcess: after nTerms terms if nTerms > 0 (and then
+ * only once under the tolerance if finalCheck), otherwise once the
+ * largest |M_k(i,j)| is within the tolerance.
+ * Returns NOK if there is no kernel for n.
+ */
+int smallTaylor(long n, const double *a, double *s, double tolerance, long nTerms, int finalCheck);
+
+#endif
@@ -0,0 +1,260 @@
+#include "tiled_matrix.h"
+#include "perf_counters.h"
+#include "memory.h"
+
+/**
+ * Size of the first half of a dimension of the recursion
+ * (a dimension of one tile isn't split)
+ */
+static long firstHalf(long nTiles)
+{
+    return nTiles > 1 ? (nTiles + 1) / 2 : nTiles;
+}
+
+/**
+ * Position of tile (ti, tj) in a grid of nRows x nColumns tiles
+ */
+static long tileSlot(long ti, long tj, long nRows, long nColumns)
+{
+    long slot = 0;
+
+    while (nRows > 1 || nColumns > 1)
+    {
+        long r0 = firstHalf(nRows);
+        long c0 = firstHalf(nColumns);
+
+        // Quadrants in order 00, 01, 10, 11
+        if (ti >= r0)
+        {
+            slot += r0 * nColumns;
+            ti -= r0;
+            nRows -= r0;
+        }
+        else
+        {
+            nRows = r0;
+        }
+
+        if (tj >= c0)
+        {
+            slot += nRows * c0;
+            tj -= c0;
+            nColumns -= c0;
+        }
+        else
+        {
+            nColumns = c0;
+        }
+    }
+
+    return slot;
+}
+
+/**
+ * Copies every tile of from to to, from the row-major to the tiled
+ * layout or back
+ */
+static int convertTiles(const Matrix *from, double *to, long panelWidth, int toTiles)
+{
+    long tileLength = TILE_SIZE * TILE_SIZE;
+    long nTileRows = from->nRows / TILE_SIZE;
+    long nTileColumns = panelWidth / TILE_SIZE;
+
+    if (from->nRows % TILE_SIZE != 0 || panelWidth % TILE_SIZE != 0 || from->nColumns % panelWidth != 0)
+    {
+        return NOK;
+    }
+
+    for (long panel = 0; panel < from->nColumns / panelWidth; panel++)
+    {
+        for (long ti = 0; ti < nTileRows; ti++)
+        {
+            for (long tj = 0; tj < nTileColumns; tj++)
+            {
+                long tile = panel * from->nRows * panelWidth + tileSlot(ti, tj, nTileRows, nTileColumns) * tileLength;
+                long rows = ti * TILE_SIZE * from->nColumns + panel * panelWidth + tj * TILE_SIZE;
+
+                for (long i = 0; i < TILE_SIZE; i++)
+                {
+                    if (toTiles)
+                    {
+                        memcpy(to + tile + i * TILE_SIZE, from->data + rows + i * from->nColumns, sizeof(double) * TILE_SIZE);
+                    }
+                    else
+                    {
+                        memcpy(to + rows + i * from->nColumns, from->data + tile + i * TILE_SIZE, sizeof(double) * TILE_SIZE);
+                    }
+                }
+            }
+        }
+    }
+
+    return OK;
+}
+
+/**
+ * In place conversion, through a copy of the data
+ */
+static int convertMatrix(Matrix *m, long panelWidth, int toTiles)
+{
+    double *data = (double *)allocateTracked(sizeof(double) * m->nRows * m->nColumns, MEMORY_MATRICES);
+
+    if (convertTiles(m, data, panelWidth, toTiles) != OK)
+    {
+        freeTracked(data);
+        return NOK;
+    }
+
+    freeTracked(m->data);
+    m->data = data;
+
+    return OK;
+}
+
+int tileMatrix(Matrix *m, long panelWidth)
+{
+    return convertMatrix(m, panelWidth, 1);
+}
+
+int untileMatrix(Matrix *m, long panelWidth)
+{
+    return convertMatrix(m, panelWidth, 0);
+}
+
+int tileMatrixTo(const Matrix *m, Matrix *tiled, long panelWidth)
+{
+    return convertTiles(m, tiled->data, panelWidth, 1);
+}
+
+int untileMatrixTo(const Matrix *tiled, Matrix *m, long panelWidth)
+{
+    return convertTiles(tiled, m->data, panelWidth, 0);
+}
+
+long tiledIndex(long i, long j, long nRows, long panelWidth)
+{
+    long panel = j / panelWidth;
+    long ti = i / TILE_SIZE;
+    long tj = (j % panelWidth) / TILE_SIZE;
+
+    return panel * nRows * panelWidth +
+           tileSlot(ti, tj, nRows / TILE_SIZE, panelWidth / TILE_SIZE) * TILE_SIZE * TILE_SIZE +
+           (i % TILE_SIZE) * TILE_SIZE + j % TILE_SIZE;
+}
+
+/**
+ * c += a * b for three contiguous tiles
+ */
+static void multiplyTile(const double *a, const double *b, double *c)
+{
+    for (long i = 0; i < TILE_SIZE; i++)
+    {
+        for (long k = 0; k < TILE_SIZE; k++)
+        {
+            double aik = a[i * TILE_SIZE + k];
+            const double *brow = b + k * TILE_SIZE;
+            double *crow = c + i * TILE_SIZE;
+
+            for (long j = 0; j < TILE_SIZE; j++)
+            {
+                crow[j] += aik * brow[j];
+            }
+        }
+    }
+}
+
+/**
+ * c (l x n tiles) += a (l x m tiles) * b (m x n tiles), following the
+ * quadrant split of the layout
+ */
+static void multiplyTiles(const double *a, const double *b, double *c, long l, long m, long n, int parallel)
+{
+    if (l == 1 && m == 1 && n == 1)
+    {
+        multiplyTile(a, b, c);
+        return;
+    }
+
+    long tileLength = TILE_SIZE * TILE_SIZE;
+    long lh[2] = {firstHalf(l), l - firstHalf(l)};
+    long mh[2] = {firstHalf(m), m - firstHalf(m)};
+    long nh[2] = {firstHalf(n), n - firstHalf(n)};
+
+    // Quadrant offsets (in tiles) in order 00, 01, 10, 11
+    long aq[2][2] = {{0, lh[0] * mh[0]}, {lh[0] * m, lh[0] * m + lh[1] * mh[0]}};
+    long bq[2][2] = {{0, mh[0] * nh[0]}, {mh[0] * n, mh[0] * n + mh[1] * nh[0]}};
+    long cq[2][2] = {{0, lh[0] * nh[0]}, {lh[0] * n, lh[0] * n + lh[1] * nh[0]}};
+
+    for (int i = 0; i < 2; i++)
+    {
+        for (int j = 0; j < 2; j++)
+        {
+            for (int k = 0; k < 2; k++)
+            {
+                if (lh[i] == 0 || mh[k] == 0 || nh[j] == 0)
+                {
+                    continue;
+                }
+
+                // The products of an output quadrant are ordered by
+                // their dependency on it
+#ifdef _OPENMP
+#pragma omp task if (parallel && l * m * n * tileLength * TILE_SIZE > 8 * TASK_THRESHOLD) \
+    depend(inout : c[cq[i][j] * tileLength])
+#endif
+                multiplyTiles(a + aq[i][k] * tileLength,
+                              b + bq[k][j] * tileLength,
+                              c + cq[i][j] * tileLength,
+                              lh[i],
+                              mh[k],
+                              nh[j],
+                              parallel);
+            }
+        }
+    }
+
+#ifdef _OPENMP
+#pragma omp taskwait
+#endif
+}
+
+int multiplyTiledAndSum(const Matrix *a, const Matrix *b, Matrix *multiplied, long aPanel, long panelWidth)
+{
+    long nTileRows = a->nRows / TILE_SIZE;
+    long nTilePanel = panelWidth / TILE_SIZE;
+    long aPanelLength = a->nRows * panelWidth;
+    long bPanelLength = b->nRows * panelWidth;
+
+    int parallel = 0;
+
+#ifdef _OPENMP
+    parallel = omp_get_max_threads() > 1 && !omp_in_parallel();
+#endif
+
+    perfStart(PERF_KERNEL_MULTIPLY);
+
+    // Every panel of the result is a task
+#ifdef _OPENMP
+#pragma omp parallel if (parallel)
+#pragma omp single
+#endif
+    for (long panel = 0; panel < b->nColumns / panelWidth; panel++)
+    {
+#ifdef _OPENMP
+#pragma omp task if (parallel)
+#endif
+        multiplyTiles(a->data + aPanel * aPanelLength,
+                      b->data + panel * bPanelLength,
+                      multiplied->data + panel * aPanelLength,
+                      nTileRows,
+                      nTilePanel,
+                      nTilePanel,
+                      parallel);
+    }
+
+    perfStop(PERF_KERNEL_MULTIPLY,
+             2.0 * a->nRows * panelWidth * b->nColumns,
+             sizeof(double) * ((double)a->nRows * panelWidth + (double)b->nRows * b->nColumns + 2.0 * a->nRows * b->nColumns));
+
+    return OK;
+}
@@ -0,0 +1,60 @@
+#ifndef __TILED_MATRIX_H__
+#define __TILED_MATRIX_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util.h"
+#include "matrix.h"
+
+/**
+ * Tiled storage (-Z) for the Matrix data.
+ *
+ * The matrix is split into column panels of panelWidth columns, stored
+ * one after the other. Each panel is a grid of TILE_SIZE x TILE_SIZE
+ * tiles (row-major inside) stored in the order of the recursive
+ * quadrant split: a Z (Morton) order that also works when the grid
+ * isn't a power of 2. Every quadrant of the recursion, and so every
+ * subproblem of multiplyTiledAndSum, is contiguous in memory.
+ *
+ * nRows and panelWidth must be multiples of TILE_SIZE. Matrices with
+ * the same dimensions and panel width have the same layout, so the
+ * element-wise functions (sumMatrix, sumTaylorTerm, maxMij,
+ * divideMatrixByLong...) work on them unchanged.
+ */
+
+/**
+ * Converts m from row-major to the tiled layout, in place
+ */
+int tileMatrix(Matrix *m, long panelWidth);
+
+/**
+ * Converts m from the tiled layout back to row-major, in place
+ */
+int untileMatrix(Matrix *m, long panelWidth);
+
+/**
+ * Copies the row-major m to tiled in the tiled layout (same dimensions),
+ * without a temporary copy of the data
+ */
+int tileMatrixTo(const Matrix *m, Matrix *tiled, long panelWidth);
+
+/**
+ * Copies the tiled matrix to m in row-major (same dimensions)
+ */
+int untileMatrixTo(const Matrix *tiled, Matrix *m, long panelWidth);
+
+/**
+ * Position of m(i, j) in the tiled layout of a matrix with nRows rows
+ */
+long tiledIndex(long i, long j, long nRows, long panelWidth);
+
+/**
+ * multiplied += A(:, panel aPanel) * B, all in the tiled layout.
+ * B has panelWidth rows, A and multiplied the same number of rows, and
+ * all of them have the same number of columns.
+ */
+int multiplyTiledAndSum(const Matrix *a, const Matrix *b, Matrix *multiplied, long aPanel, long panelWidth);
+
+#endif
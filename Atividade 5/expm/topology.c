@@ -0,0 +1,368 @@
+// sched_setaffinity
+#define _GNU_SOURCE
+#include <sched.h>
+
+#include "topology.h"
+
+/**
+ * Sort key of a cpu
+ */
+typedef struct cpu_place
+{
+    int numaNode;
+    int l3;
+    int core;
+    int cpu;
+} CpuPlace;
+
+/**
+ * Reads a cpu list like "0-3,8,10-11" into mask.
+ * Returns the first cpu or -1 if the file can't be read.
+ */
+static int readCpuList(const char *path, char *mask, int nCpus)
+{
+    FILE *fp = fopen(path, "r");
+    int first = -1, from, to;
+    char separator;
+
+    if (fp == NULL)
+    {
+        return -1;
+    }
+
+    memset(mask, 0, nCpus);
+
+    while (fscanf(fp, "%d", &from) == 1)
+    {
+        to = from;
+        separator = fgetc(fp);
+
+        if (separator == '-')
+        {
+            if (fscanf(fp, "%d", &to) != 1)
+            {
+                break;
+            }
+            separator = fgetc(fp);
+        }
+
+        for (int c = from; c <= to && c < nCpus; c++)
+        {
+            mask[c] = 1;
+        }
+
+        if (first == -1 || from < first)
+        {
+            first = from;
+        }
+
+        if (separator != ',')
+        {
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    return first;
+}
+
+static int readInt(const char *path, int *value)
+{
+    FILE *fp = fopen(path, "r");
+
+    if (fp == NULL)
+    {
+        return NOK;
+    }
+
+    int res = fscanf(fp, "%d", value) == 1 ? OK : NOK;
+    fclose(fp);
+
+    return res;
+}
+
+static int compareCpuPlaces(const void *a, const void *b)
+{
+    const CpuPlace *x = (const CpuPlace *)a;
+    const CpuPlace *y = (const CpuPlace *)b;
+
+    if (x->numaNode != y->numaNode)
+    {
+        return x->numaNode - y->numaNode;
+    }
+    if (x->l3 != y->l3)
+    {
+        return x->l3 - y->l3;
+    }
+    if (x->core != y->core)
+    {
+        return x->core - y->core;
+    }
+    return x->cpu - y->cpu;
+}
+
+Topology *discoverTopology()
+{
+    Topology *topo = (Topology *)malloc(sizeof(Topology));
+    char path[256];
+
+    int nCpus = (int)sysconf(_SC_NPROCESSORS_CONF);
+    if (nCpus < 1)
+    {
+        nCpus = 1;
+    }
+
+    char *mask = (char *)malloc(nCpus);
+    CpuPlace *places = (CpuPlace *)malloc(sizeof(CpuPlace) * nCpus);
+
+    topo->nCpus = nCpus;
+    topo->numaNode = (int *)malloc(sizeof(int) * nCpus);
+    topo->l3 = (int *)malloc(sizeof(int) * nCpus);
+    topo->core = (int *)malloc(sizeof(int) * nCpus);
+    topo->order = (int *)malloc(sizeof(int) * nCpus);
+
+    for (int c = 0; c < nCpus; c++)
+    {
+        topo->numaNode[c] = 0;
+
+        // SMT siblings
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", c);
+        topo->core[c] = readCpuList(path, mask, nCpus);
+        if (topo->core[c] == -1)
+        {
+            topo->core[c] = c;
+        }
+
+        // The cpus sharing the L3 cache
+        topo->l3[c] = -1;
+        for (int index = 0;; index++)
+        {
+            int level = 0;
+
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", c, index);
+            if (readInt(path, &level) != OK)
+            {
+                break;
+            }
+
+            if (level == 3)
+            {
+                snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", c, index);
+                topo->l3[c] = readCpuList(path, mask, nCpus);
+                break;
+            }
+        }
+    }
+
+    // NUMA nodes (the node ids are at most the number of cpus)
+    for (int node = 0; node < nCpus; node++)
+    {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        if (readCpuList(path, mask, nCpus) == -1)
+        {
+            continue;
+        }
+
+        for (int c = 0; c < nCpus; c++)
+        {
+            if (mask[c])
+            {
+                topo->numaNode[c] = node;
+            }
+        }
+    }
+
+    for (int c = 0; c < nCpus; c++)
+    {
+        // No L3 information: group by NUMA node
+        if (topo->l3[c] == -1)
+        {
+            topo->l3[c] = nCpus + topo->numaNode[c];
+        }
+
+        places[c].numaNode = topo->numaNode[c];
+        places[c].l3 = topo->l3[c];
+        places[c].core = topo->core[c];
+        places[c].cpu = c;
+    }
+
+    qsort(places, nCpus, sizeof(CpuPlace), compareCpuPlaces);
+
+    topo->nNumaNodes = topo->nL3 = topo->nCores = 0;
+
+    for (int i = 0; i < nCpus; i++)
+    {
+        topo->order[i] = places[i].cpu;
+
+        if (i == 0 || places[i].numaNode != places[i - 1].numaNode)
+        {
+            topo->nNumaNodes++;
+        }
+        if (i == 0 || places[i].l3 != places[i - 1].l3)
+        {
+            topo->nL3++;
+        }
+        if (i == 0 || places[i].core != places[i - 1].core)
+        {
+            topo->nCores++;
+        }
+    }
+
+    free(mask);
+    free(places);
+
+    return topo;
+}
+
+void destroyTopology(Topology *topo)
+{
+    if (topo == NULL)
+    {
+        return;
+    }
+
+    free(topo->numaNode);
+    free(topo->l3);
+    free(topo->core);
+    free(topo->order);
+    free(topo);
+}
+
+int placeProcess(const Topology *topo, int myrank, MPI_Comm comm)
+{
+    cpu_set_t allowed, set;
+    int *candidates = (int *)malloc(sizeof(int) * topo->nCpus);
+    int *positions = (int *)malloc(sizeof(int) * topo->nCpus);
+    int nCandidates = 0;
+    int localRank = 0, localSize = 0;
+    int first, count;
+
+    MPI_Comm nodeComm;
+
+    // The cpus the launcher lets us use, in topology order
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    for (int i = 0; i < topo->nCpus; i++)
+    {
+        if (topo->order[i] < CPU_SETSIZE && CPU_ISSET(topo->order[i], &allowed))
+        {
+            positions[nCandidates] = i;
+            candidates[nCandidates++] = topo->order[i];
+        }
+    }
+
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, myrank, MPI_INFO_NULL, &nodeComm);
+    MPI_Comm_rank(nodeComm, &localRank);
+    MPI_Comm_size(nodeComm, &localSize);
+    MPI_Comm_free(&nodeComm);
+
+    if (nCandidates == 0)
+    {
+        // Our cpus aren't in /sys: leave the process where it is
+        positions[0] = 0;
+        candidates[0] = sched_getcpu();
+        nCandidates = 1;
+    }
+
+    // A share of the cpus for each process, or one cpu if there are
+    // more processes than cpus
+    count = nCandidates / localSize;
+    if (count >= 1)
+    {
+        first = (localRank * count) % nCandidates;
+    }
+    else
+    {
+        count = 1;
+        first = localRank % nCandidates;
+    }
+
+    CPU_ZERO(&set);
+    for (int i = first; i < first + count; i++)
+    {
+        CPU_SET(candidates[i], &set);
+    }
+
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+    {
+        printf("[WARNING] Process #%d could not be pinned to cpu %d\n", myrank, candidates[first]);
+    }
+
+    int place[4] = {candidates[first],
+                    count,
+                    candidates[first] < topo->nCpus ? topo->numaNode[candidates[first]] : -1,
+                    positions[first]};
+    int *places = NULL;
+    int npes = 0;
+
+    MPI_Comm_size(comm, &npes);
+
+    if (myrank == 0)
+    {
+        places = (int *)malloc(sizeof(int) * 4 * npes);
+    }
+
+    MPI_Gather(place, 4, MPI_INT, places, 4, MPI_INT, 0, comm);
+
+    if (myrank == 0)
+    {
+        printf("Topology: %d NUMA nodes, %d L3 caches, %d cores, %d cpus\n",
+               topo->nNumaNodes,
+               topo->nL3,
+               topo->nCores,
+               topo->nCpus);
+
+        for (int p = 0; p < npes; p++)
+        {
+            printf("  Process #%d: %d cpus from cpu %d, NUMA node %d\n",
+                   p,
+                   places[4 * p + 1],
+                   places[4 * p],
+                   places[4 * p + 2]);
+        }
+
+        free(places);
+    }
+
+    int position = positions[first];
+
+    free(candidates);
+    free(positions);
+
+    return position;
+}
+
+int countAllowedCpus()
+{
+    cpu_set_t allowed;
+
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        return 1;
+    }
+
+    return CPU_COUNT(&allowed) > 0 ? CPU_COUNT(&allowed) : 1;
+}
+
+int cpusPerProcess(MPI_Comm comm)
+{
+    MPI_Comm node;
+    int nodeSize = 1;
+
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+    MPI_Comm_size(node, &nodeSize);
+    MPI_Comm_free(&node);
+
+    long share = sysconf(_SC_NPROCESSORS_ONLN) / nodeSize;
+    int allowed = countAllowedCpus();
+
+    if (share < 1)
+    {
+        share = 1;
+    }
+
+    return allowed < share ? allowed : (int)share;
+}
@@ -0,0 +1,70 @@
+#ifndef __TOPOLOGY_H__
+#define __TOPOLOGY_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <mpi.h>
+
+#include "util.h"
+
+/**
+ * Machine topology (-N) from /sys/devices/system/node and the cache
+ * and topology directories of each cpu in /sys/devices/system/cpu.
+ * Without NUMA information there is a single node, without L3
+ * information the cpus of a NUMA node share one L3, and without SMT
+ * information each cpu is a core.
+ */
+typedef struct topology
+{
+    int nCpus;
+
+    /**
+     * For each cpu: NUMA node, first cpu sharing its L3 and first cpu
+     * of its core (SMT siblings)
+     */
+    int *numaNode;
+    int *l3;
+    int *core;
+
+    /**
+     * The cpus grouped by NUMA node, L3 (CCX) and core: consecutive
+     * cpus are as close as possible
+     */
+    int *order;
+
+    int nNumaNodes;
+    int nL3;
+    int nCores;
+} Topology;
+
+Topology *discoverTopology();
+
+void destroyTopology(Topology *topo);
+
+/**
+ * Pins this process to its share of the cpus it is allowed to use on
+ * its node, taken in topology order by node-local rank, so that ranks
+ * next to each other share an L3 and a NUMA node. Must be called by
+ * every process of comm before the matrices are allocated: the memory
+ * is then first touched on the NUMA node of its owner.
+ * Returns the position of our first cpu in topo->order, used to order
+ * the ring.
+ */
+int placeProcess(const Topology *topo, int myrank, MPI_Comm comm);
+
+/**
+ * Number of cpus this process is allowed to run on
+ */
+int countAllowedCpus();
+
+/**
+ * Cpus this process can use without taking them from the other
+ * processes of its node: the cpus it is allowed to run on, but no more
+ * than its share of the node's cpus when the processes aren't bound.
+ * Must be called by every process of comm.
+ */
+int cpusPerProcess(MPI_Comm comm);
+
+#endif
@@ -0,0 +1,747 @@
+#include "transport.h"
+
+MPI_Datatype createRowType(long nColumns)
+{
+    MPI_Datatype rowType;
+
+    MPI_Type_contiguous(nColumns, MPI_DOUBLE, &rowType);
+    MPI_Type_commit(&rowType);
+
+    return rowType;
+}
+
+/**
+ * Builds a communicator where the processes of each node have
+ * contiguous ranks. The rank 0 of the parent communicator is kept as
+ * rank 0.
+ * If position >= 0 (see placeProcess) the processes of a node are
+ * ordered by the position of their cpus, rotated so the node leader
+ * stays first: ring neighbours then share an L3 when they can.
+ */
+static int createNodeComms(Transport *t, MPI_Comm parent, int position)
+{
+    int parentRank = 0, parentSize = 0;
+    int nodeRank = 0, nodeSize = 0;
+    int nodeIndex = 0, nLeaders = 0;
+
+    MPI_Comm_rank(parent, &parentRank);
+    MPI_Comm_size(parent, &parentSize);
+
+    MPI_Comm_split_type(parent,
+                        MPI_COMM_TYPE_SHARED,
+                        parentRank,
+                        MPI_INFO_NULL,
+                        &t->nodeComm);
+
+    MPI_Comm_rank(t->nodeComm, &nodeRank);
+    MPI_Comm_size(t->nodeComm, &nodeSize);
+
+    MPI_Comm_split(parent,
+                   nodeRank == 0 ? 0 : MPI_UNDEFINED,
+                   parentRank,
+                   &t->leaderComm);
+
+    if (t->leaderComm != MPI_COMM_NULL)
+    {
+        MPI_Comm_rank(t->leaderComm, &nodeIndex);
+        MPI_Comm_size(t->leaderComm, &nLeaders);
+
+        t->nodeCounts = (int *)malloc(nLeaders * sizeof(int));
+        t->nodeDispls = (int *)malloc(nLeaders * sizeof(int));
+
+        MPI_Allgather(&nodeSize,
+                      1,
+                      MPI_INT,
+                      t->nodeCounts,
+                      1,
+                      MPI_INT,
+                      t->leaderComm);
+
+        for (int i = 0, displ = 0; i < nLeaders; i++)
+        {
+            t->nodeCounts[i] *= t->nRows;
+            t->nodeDispls[i] = displ;
+            displ += t->nodeCounts[i];
+        }
+    }
+
+    MPI_Bcast(&nodeIndex, 1, MPI_INT, 0, t->nodeComm);
+
+    int key = nodeRank;
+
+    if (position >= 0)
+    {
+        int *positions = (int *)malloc(sizeof(int) * nodeSize);
+
+        MPI_Allgather(&position, 1, MPI_INT, positions, 1, MPI_INT, t->nodeComm);
+
+        // Processes before us in the rotated cpu order
+        key = 0;
+        for (int i = 0; i < nodeSize; i++)
+        {
+            long other = positions[i] - (long)positions[0];
+            long mine = position - (long)positions[0];
+
+            other = other < 0 ? other + INT_MAX : other;
+            mine = mine < 0 ? mine + INT_MAX : mine;
+
+            key += other < mine || (other == mine && i < nodeRank);
+        }
+
+        free(positions);
+    }
+
+    MPI_Comm_split(parent, 0, nodeIndex * parentSize + key, &t->comm);
+
+    return OK;
+}
+
+Transport *createTransport(int type, MPI_Comm parent, long nRows, long nColumns, int position)
+{
+    Transport *t = (Transport *)malloc(sizeof(Transport));
+
+    t->type = type;
+    t->nRows = nRows;
+    t->dataLength = nRows * nColumns;
+    t->rowType = createRowType(nColumns);
+    t->strassenCutoff = 0;
+    t->tiled = 0;
+    t->outOfCore = 0;
+    t->recvBuffer = NULL;
+    t->windowBytes = 0;
+    t->compression = COMPRESSION_NONE;
+    t->compressionError = 0.0;
+    t->packed[0] = t->packed[1] = NULL;
+    t->packedSize = 0;
+    t->sentBytes = 0.0;
+    t->rawBytes = 0.0;
+    t->nodeComm = MPI_COMM_NULL;
+    t->leaderComm = MPI_COMM_NULL;
+    t->window = MPI_WIN_NULL;
+    t->fullM = NULL;
+    t->nodeCounts = NULL;
+    t->nodeDispls = NULL;
+    t->slots[0] = t->slots[1] = NULL;
+    t->current = 0;
+    t->fetchBuffers[0] = t->fetchBuffers[1] = NULL;
+
+    if (type == TRANSPORT_SHM)
+    {
+        createNodeComms(t, parent, position);
+    }
+    else if (position >= 0)
+    {
+        // Only the process order is needed
+        createNodeComms(t, parent, position);
+
+        if (t->leaderComm != MPI_COMM_NULL)
+        {
+            MPI_Comm_free(&t->leaderComm);
+        }
+        MPI_Comm_free(&t->nodeComm);
+        free(t->nodeCounts);
+        free(t->nodeDispls);
+        t->nodeCounts = t->nodeDispls = NULL;
+    }
+    else
+    {
+        MPI_Comm_dup(parent, &t->comm);
+    }
+
+    MPI_Comm_rank(t->comm, &t->myrank);
+    MPI_Comm_size(t->comm, &t->npes);
+
+    t->multiplyTime = 0.0;
+    t->rowCounts = (long *)malloc(sizeof(long) * t->npes);
+    t->rowOffsets = (long *)malloc(sizeof(long) * t->npes);
+
+    for (int p = 0; p < t->npes; p++)
+    {
+        t->rowCounts[p] = nRows;
+        t->rowOffsets[p] = p * nRows;
+    }
+
+    if (type == TRANSPORT_SHM)
+    {
+        double *base = NULL;
+        MPI_Aint size = 0;
+        int dispUnit = 0;
+
+        // Only the leader allocates memory: the window is contiguous
+        // across the node and holds the full M_k matrix
+        t->windowBytes = t->leaderComm != MPI_COMM_NULL ? sizeof(double) * t->dataLength * t->npes : 0;
+
+        MPI_Win_allocate_shared(
+            t->windowBytes,
+            sizeof(double),
+            MPI_INFO_NULL,
+            t->nodeComm,
+            &base,
+            &t->window);
+        trackMemory(MEMORY_WINDOWS, t->windowBytes);
+
+        MPI_Win_shared_query(t->window, 0, &size, &dispUnit, &base);
+
+        // We can't use createMatrix: the data belongs to the window
+        t->fullM = (Matrix *)malloc(sizeof(Matrix));
+        t->fullM->nRows = nRows * t->npes;
+        t->fullM->nColumns = nColumns;
+        t->fullM->data = base;
+
+        t->m = (Matrix *)malloc(sizeof(Matrix));
+        t->m->nRows = nRows;
+        t->m->nColumns = nColumns;
+        t->m->data = base + t->myrank * t->dataLength;
+
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, t->window);
+    }
+    else if (type == TRANSPORT_RMA)
+    {
+        double *base = NULL;
+
+        t->windowBytes = sizeof(double) * t->dataLength * 2;
+
+        MPI_Win_allocate(t->windowBytes,
+                         sizeof(double),
+                         MPI_INFO_NULL,
+                         t->comm,
+                         &base,
+                         &t->window);
+        trackMemory(MEMORY_WINDOWS, t->windowBytes);
+
+        t->slots[0] = base;
+        t->slots[1] = base + t->dataLength;
+
+        // We can't use createMatrix: the data belongs to the window
+        t->m = (Matrix *)malloc(sizeof(Matrix));
+        t->m->nRows = nRows;
+        t->m->nColumns = nColumns;
+        t->m->data = t->slots[t->current];
+
+        t->fetchBuffers[0] = (double *)allocateTracked(sizeof(double) * t->dataLength, MEMORY_BUFFERS);
+        t->fetchBuffers[1] = (double *)allocateTracked(sizeof(double) * t->dataLength, MEMORY_BUFFERS);
+
+        // Passive target: nobody has to take part in our MPI_Rget's
+        MPI_Win_lock_all(MPI_MODE_NOCHECK, t->window);
+    }
+    else
+    {
+        t->m = createMatrix(nRows, nColumns);
+        t->recvBuffer = (double *)allocateTracked(sizeof(double) * t->dataLength, MEMORY_BUFFERS);
+    }
+
+    return t;
+}
+
+void destroyTransport(Transport *t)
+{
+    if (t == NULL)
+    {
+        return;
+    }
+
+    if (t->type == TRANSPORT_SHM)
+    {
+        MPI_Win_unlock_all(t->window);
+        MPI_Win_free(&t->window);
+        trackMemory(MEMORY_WINDOWS, -t->windowBytes);
+
+        free(t->m);
+        free(t->fullM);
+        free(t->nodeCounts);
+        free(t->nodeDispls);
+
+        if (t->leaderComm != MPI_COMM_NULL)
+        {
+            MPI_Comm_free(&t->leaderComm);
+        }
+        MPI_Comm_free(&t->nodeComm);
+    }
+    else if (t->type == TRANSPORT_RMA)
+    {
+        MPI_Win_unlock_all(t->window);
+        MPI_Win_free(&t->window);
+        trackMemory(MEMORY_WINDOWS, -t->windowBytes);
+
+        free(t->m);
+        freeTracked(t->fetchBuffers[0]);
+        freeTracked(t->fetchBuffers[1]);
+    }
+    else
+    {
+        destroyMatrix(t->m);
+        freeTracked(t->recvBuffer);
+        free(t->packed[0]);
+        free(t->packed[1]);
+    }
+
+    free(t->rowCounts);
+    free(t->rowOffsets);
+    MPI_Type_free(&t->rowType);
+    MPI_Comm_free(&t->comm);
+    free(t);
+}
+
+/**
+ * multiplied += A(:, rows of owner) * block, where block holds the
+ * M_k-1 rows of owner
+ */
+static void multiplyBlock(Transport *t, const Matrix *a, const Matrix *block, int owner, Matrix *multiplied)
+{
+    double ti = MPI_Wtime();
+
+    if (t->outOfCore)
+    {
+        // Every transport multiplies the blocks in owner order: read
+        // the next panel of A while this one is multiplied
+        long panelLength = a->nRows * t->nRows;
+
+        prefetchScratch(a->data + ((owner + 1) % t->npes) * panelLength, panelLength);
+
+        multiplyTiledAndSum(a, block, multiplied, owner, t->nRows);
+
+        releaseScratch(a->data + owner * panelLength, panelLength);
+    }
+    else if (t->tiled)
+    {
+        multiplyTiledAndSum(a, block, multiplied, owner, t->nRows);
+    }
+    else
+    {
+        multiplyMatrixAndSumStrassen(a,
+                                     block,
+                                     multiplied,
+                                     0,
+                                     t->rowOffsets[owner],
+                                     0,
+                                     0,
+                                     0,
+                                     0,
+                                     a->nRows,
+                                     block->nRows,
+                                     block->nColumns,
+                                     t->strassenCutoff);
+    }
+
+    t->multiplyTime += MPI_Wtime() - ti;
+}
+
+/**
+ * Rotates the M_k-1 blocks through all the processes
+ */
+static int ringMultiply(Transport *t, const Matrix *a, Matrix *multiplied)
+{
+    Matrix *m = t->m;
+    int myrank = t->myrank;
+    int npes = t->npes;
+
+    /**
+     * Block being multiplied. The blocks may have different sizes.
+     */
+    Matrix block = *m;
+
+    /**
+     * Temp array for faster buffer unload
+     */
+    double *tmp;
+
+    /**
+     * MPI_Requests to control delivery
+     */
+    MPI_Request mSendRequest, mRecvRequest;
+
+    for (int p = 0; p < npes; p++)
+    {
+        // Owner of the block we have and of the next one
+        int owner = (myrank + p) % npes;
+        int nextOwner = (myrank + p + 1) % npes;
+
+        if (p < npes - 1)
+        {
+            // Send / retrieve the next m
+            MPI_Irecv(t->recvBuffer,
+                      t->rowCounts[nextOwner],
+                      t->rowType,
+                      (myrank + 1) % npes,
+                      MESSAGE_TAG_M_LINE,
+                      t->comm,
+                      &mRecvRequest);
+
+            MPI_Isend(m->data,
+                      t->rowCounts[owner],
+                      t->rowType,
+                      (npes + myrank - 1) % npes,
+                      MESSAGE_TAG_M_LINE,
+                      t->comm,
+                      &mSendRequest);
+
+            t->sentBytes += sizeof(double) * t->rowCounts[owner] * m->nColumns;
+            t->rawBytes += sizeof(double) * t->rowCounts[owner] * m->nColumns;
+        }
+
+        block.data = m->data;
+        block.nRows = t->rowCounts[owner];
+
+        multiplyBlock(t, a, &block, owner, multiplied);
+
+        if (p < npes - 1)
+        {
+            MPI_Wait(&mRecvRequest, MPI_STATUS_IGNORE);
+            MPI_Wait(&mSendRequest, MPI_STATUS_IGNORE);
+
+            tmp = m->data;
+            m->data = t->recvBuffer;
+            t->recvBuffer = tmp;
+        }
+    }
+
+    return OK;
+}
+
+/**
+ * Ring rotation of compressed blocks. Each block is compressed once by
+ * its owner and forwarded as it was received, so the error doesn't
+ * grow along the ring. Our own block is multiplied uncompressed.
+ */
+static int compressedRingMultiply(Transport *t, const Matrix *a, Matrix *multiplied)
+{
+    int myrank = t->myrank;
+    int npes = t->npes;
+    long nColumns = t->m->nColumns;
+    long size = maxCompressedSize(transportMaxRows(t) * nColumns);
+
+    Matrix block = *t->m;
+
+    long packedLength;
+    int received = 0;
+    char *tmp;
+
+    MPI_Request mSendRequest, mRecvRequest;
+
+    if (size > INT_MAX || t->compressionError <= 0.0)
+    {
+        // Too large for a byte count, or no error allowed
+        return ringMultiply(t, a, multiplied);
+    }
+
+    if (size > t->packedSize)
+    {
+        free(t->packed[0]);
+        free(t->packed[1]);
+        t->packed[0] = (char *)malloc(size);
+        t->packed[1] = (char *)malloc(size);
+        t->packedSize = size;
+    }
+
+    packedLength = compressBlock(t->m->data,
+                                 t->rowCounts[myrank] * nColumns,
+                                 t->compression,
+                                 t->compressionError,
+                                 t->packed[0]);
+
+    for (int p = 0; p < npes; p++)
+    {
+        int owner = (myrank + p) % npes;
+
+        if (p < npes - 1)
+        {
+            MPI_Irecv(t->packed[1],
+                      (int)t->packedSize,
+                      MPI_BYTE,
+                      (myrank + 1) % npes,
+                      MESSAGE_TAG_M_LINE,
+                      t->comm,
+                      &mRecvRequest);
+
+            MPI_Isend(t->packed[0],
+                      (int)packedLength,
+                      MPI_BYTE,
+                      (npes + myrank - 1) % npes,
+                      MESSAGE_TAG_M_LINE,
+                      t->comm,
+                      &mSendRequest);
+
+            t->sentBytes += packedLength;
+            t->rawBytes += sizeof(double) * t->rowCounts[owner] * nColumns;
+        }
+
+        block.nRows = t->rowCounts[owner];
+
+        if (p == 0)
+        {
+            block.data = t->m->data;
+        }
+        else
+        {
+            // Unpack the block we received before multiplying it
+            decompressBlock(t->packed[0], block.nRows * nColumns, t->recvBuffer);
+            block.data = t->recvBuffer;
+        }
+
+        multiplyBlock(t, a, &block, owner, multiplied);
+
+        if (p < npes - 1)
+        {
+            MPI_Status status;
+
+            MPI_Wait(&mRecvRequest, &status);
+            MPI_Wait(&mSendRequest, MPI_STATUS_IGNORE);
+            MPI_Get_count(&status, MPI_BYTE, &received);
+
+            // Forward what we got
+            tmp = t->packed[0];
+            t->packed[0] = t->packed[1];
+            t->packed[1] = tmp;
+            packedLength = received;
+        }
+    }
+
+    return OK;
+}
+
+long transportMaxRows(const Transport *t)
+{
+    long max = 0;
+
+    for (int p = 0; p < t->npes; p++)
+    {
+        if (t->rowCounts[p] > max)
+        {
+            max = t->rowCounts[p];
+        }
+    }
+
+    return max;
+}
+
+int transportReleaseBuffers(Transport *t)
+{
+    if (t->type != TRANSPORT_RING)
+    {
+        return NOK;
+    }
+
+    destroyMatrix(t->m);
+    freeTracked(t->recvBuffer);
+
+    t->m = NULL;
+    t->recvBuffer = NULL;
+
+    return OK;
+}
+
+int transportSetDistribution(Transport *t, const long *rowCounts, Matrix *m)
+{
+    if (t->type != TRANSPORT_RING)
+    {
+        return NOK;
+    }
+
+    long offset = 0;
+
+    for (int p = 0; p < t->npes; p++)
+    {
+        t->rowCounts[p] = rowCounts[p];
+        t->rowOffsets[p] = offset;
+        offset += rowCounts[p];
+    }
+
+    destroyMatrix(t->m);
+    freeTracked(t->recvBuffer);
+
+    t->m = m;
+    t->nRows = m->nRows;
+    t->dataLength = m->nRows * m->nColumns;
+    t->recvBuffer = (double *)allocateTracked(sizeof(double) * transportMaxRows(t) * m->nColumns, MEMORY_BUFFERS);
+
+    return OK;
+}
+
+/**
+ * Fetches the M_k-1 blocks from the other processes' windows.
+ * The next block is requested before multiplying the current one.
+ */
+static int rmaMultiply(Transport *t, const Matrix *a, Matrix *multiplied)
+{
+    int myrank = t->myrank;
+    int npes = t->npes;
+
+    /**
+     * Block being multiplied. Starts with our own block.
+     */
+    Matrix block = *t->m;
+
+    MPI_Request requests[2];
+
+    // Make sure we see the last blocks written by the others
+    MPI_Win_sync(t->window);
+
+    for (int p = 0; p < npes; p++)
+    {
+        if (p > 0)
+        {
+            MPI_Wait(&requests[(p - 1) % 2], MPI_STATUS_IGNORE);
+            block.data = t->fetchBuffers[(p - 1) % 2];
+        }
+
+        if (p < npes - 1)
+        {
+            // Prefetch the next block
+            MPI_Rget(t->fetchBuffers[p % 2],
+                     t->nRows,
+                     t->rowType,
+                     (myrank + p + 1) % npes,
+                     t->current * t->dataLength,
+                     t->nRows,
+                     t->rowType,
+                     t->window,
+                     &requests[p % 2]);
+        }
+
+        multiplyBlock(t, a, &block, (myrank + p) % npes, multiplied);
+    }
+
+    return OK;
+}
+
+int transportMultiply(Transport *t, const Matrix *a, Matrix *multiplied)
+{
+    if (t->type == TRANSPORT_SHM && t->tiled)
+    {
+        // Every block of M_k-1 is already in the node window, one
+        // after the other
+        Matrix block = *t->m;
+
+        for (int p = 0; p < t->npes; p++)
+        {
+            block.data = t->fullM->data + p * t->dataLength;
+            multiplyBlock(t, a, &block, p, multiplied);
+        }
+
+        return OK;
+    }
+
+    if (t->type == TRANSPORT_SHM)
+    {
+        double ti = MPI_Wtime();
+
+        // Every block of M_k-1 is already in the node window
+        multiplyMatrixAndSumStrassen(a,
+                                     t->fullM,
+                                     multiplied,
+                                     0,
+                                     0,
+                                     0,
+                                     0,
+                                     0,
+                                     0,
+                                     a->nRows,
+                                     t->fullM->nRows,
+                                     t->fullM->nColumns,
+                                     t->strassenCutoff);
+
+        t->multiplyTime += MPI_Wtime() - ti;
+
+        return OK;
+    }
+
+    if (t->type == TRANSPORT_RMA)
+    {
+        return rmaMultiply(t, a, multiplied);
+    }
+
+    if (t->compression != COMPRESSION_NONE)
+    {
+        return compressedRingMultiply(t, a, multiplied);
+    }
+
+    return ringMultiply(t, a, multiplied);
+}
+
+int transportSwap(Transport *t, Matrix *multiplied)
+{
+    double *tmp;
+
+    if (t->type == TRANSPORT_SHM)
+    {
+        // Wait until everyone on the node is done reading M_k-1
+        MPI_Barrier(t->nodeComm);
+
+        memcpy(t->m->data, multiplied->data, sizeof(double) * t->dataLength);
+
+        return OK;
+    }
+
+    if (t->type == TRANSPORT_RMA)
+    {
+        // The other slot holds M_k-2, which nobody reads anymore:
+        // every process finished the previous term before the
+        // convergence check let us continue
+        t->current = 1 - t->current;
+        t->m->data = t->slots[t->current];
+
+        memcpy(t->m->data, multiplied->data, sizeof(double) * t->dataLength);
+
+        return OK;
+    }
+
+    tmp = t->m->data;
+    t->m->data = multiplied->data;
+    multiplied->data = tmp;
+
+    return OK;
+}
+
+int transportPublish(Transport *t)
+{
+    if (t->type == TRANSPORT_RMA)
+    {
+        // The others may read the block as soon as they need it
+        MPI_Win_sync(t->window);
+        return OK;
+    }
+
+    if (t->type != TRANSPORT_SHM)
+    {
+        // Ring blocks are sent when they are needed
+        return OK;
+    }
+
+    // Every block of this node is written
+    MPI_Win_sync(t->window);
+    MPI_Barrier(t->nodeComm);
+
+    if (t->leaderComm != MPI_COMM_NULL)
+    {
+        int nLeaders = 0;
+        MPI_Comm_size(t->leaderComm, &nLeaders);
+
+        if (nLeaders > 1)
+        {
+            // Exchange the node blocks with the other nodes
+            MPI_Allgatherv(MPI_IN_PLACE,
+                           0,
+                           MPI_DATATYPE_NULL,
+                           t->fullM->data,
+                           t->nodeCounts,
+                           t->nodeDispls,
+                           t->rowType,
+                           t->leaderComm);
+        }
+    }
+
+    MPI_Barrier(t->nodeComm);
+    MPI_Win_sync(t->window);
+
+    return OK;
+}
+
+int transportSync(Transport *t)
+{
+    if (t->type == TRANSPORT_RMA)
+    {
+        MPI_Barrier(t->comm);
+    }
+
+    return OK;
+}
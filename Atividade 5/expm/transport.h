@@ -0,0 +1,211 @@
+#ifndef __TRANSPORT_H__
+#define __TRANSPORT_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <mpi.h>
+
+#include "matrix.h"
+#include "memory.h"
+#include "tiled_matrix.h"
+#include "compression.h"
+#include "out_of_core.h"
+
+/**
+ * Moves the M_k blocks between processes so that each process can
+ * multiply its rows of A by the full M_k matrix.
+ *
+ * TRANSPORT_RING: every block is rotated through all the processes
+ * using MPI_Isend / MPI_Irecv
+ *
+ * TRANSPORT_SHM: processes on the same node share a single copy of M_k
+ * in a MPI_Win_allocate_shared window and read each other's blocks in
+ * place. Only the node leaders exchange blocks over the network.
+ *
+ * TRANSPORT_RMA: every process exposes its M_k block in a MPI_Win and
+ * fetches the blocks it needs with MPI_Rget, prefetching the next block
+ * while multiplying the current one. The processes don't have to wait
+ * for each other on every step.
+ */
+typedef struct transport
+{
+    int type;
+
+    /**
+     * Communicator used for the computation.
+     * For TRANSPORT_SHM the processes are ordered by node, so each node
+     * owns a contiguous range of rows.
+     */
+    MPI_Comm comm;
+    int myrank;
+    int npes;
+
+    // Number of rows and items in each M_k block
+    long nRows;
+    long dataLength;
+
+    /**
+     * One matrix row. The blocks are sent as rows so the counts
+     * fit in an int for any matrix we can hold in memory.
+     */
+    MPI_Datatype rowType;
+
+    /**
+     * Local M_k block
+     */
+    Matrix *m;
+
+    /**
+     * Number of rows of each process and where they start.
+     * Only TRANSPORT_RING supports different counts, see
+     * transportSetDistribution.
+     */
+    long *rowCounts;
+    long *rowOffsets;
+
+    /**
+     * Time spent multiplying (not waiting for blocks) since it was
+     * last reset
+     */
+    double multiplyTime;
+
+    /**
+     * Block size from which the multiplications use the
+     * Strassen-Winograd recursion (0 disables it)
+     */
+    long strassenCutoff;
+
+    /**
+     * The blocks use the tiled layout, with panels of nRows columns
+     * (see tiled_matrix.h)
+     */
+    int tiled;
+
+    /**
+     * A is out of core (-O): the panel of the next block is read ahead
+     * and the one just used is dropped
+     */
+    int outOfCore;
+
+    /**
+     * TRANSPORT_RING: receive buffer for the next block
+     */
+    double *recvBuffer;
+
+    /**
+     * TRANSPORT_RING: compression of the blocks (-z) and its error
+     * bound (0 sends them uncompressed), buffers for the block we send
+     * and the one we receive (packedSize bytes each) and the bytes
+     * sent / before compression
+     */
+    int compression;
+    double compressionError;
+    char *packed[2];
+    long packedSize;
+    double sentBytes;
+    double rawBytes;
+
+    /**
+     * TRANSPORT_SHM: node communicator and node leaders communicator
+     * (MPI_COMM_NULL if we are not a leader)
+     */
+    MPI_Comm nodeComm;
+    MPI_Comm leaderComm;
+
+    /**
+     * TRANSPORT_SHM and TRANSPORT_RMA: window with the M_k blocks and
+     * the bytes we allocated for it
+     */
+    MPI_Win window;
+    long windowBytes;
+
+    /**
+     * TRANSPORT_SHM: full M_k matrix stored in the shared window
+     */
+    Matrix *fullM;
+
+    /**
+     * TRANSPORT_SHM: receive counts and displacements for each node
+     * (in rows), used by the leaders to exchange their blocks
+     */
+    int *nodeCounts;
+    int *nodeDispls;
+
+    /**
+     * TRANSPORT_RMA: the window has two slots per process, one with
+     * M_k-1 (read by the others) and one where we write M_k.
+     * current is the slot holding the latest block.
+     */
+    double *slots[2];
+    int current;
+
+    /**
+     * TRANSPORT_RMA: buffers for the blocks fetched from the others
+     */
+    double *fetchBuffers[2];
+} Transport;
+
+/**
+ * Creates a committed datatype with nColumns contiguous doubles
+ */
+MPI_Datatype createRowType(long nColumns);
+
+/**
+ * Creates the transport and allocates the local M_k block with
+ * nRows x nColumns items.
+ * position is the place of the process in the machine topology (see
+ * placeProcess), used to order the processes, or -1 to keep the order
+ * of parent.
+ */
+Transport *createTransport(int type, MPI_Comm parent, long nRows, long nColumns, int position);
+
+void destroyTransport(Transport *t);
+
+/**
+ * TRANSPORT_RING: frees the local M_k block and the receive buffer, for
+ * when the terms are computed without the transport (-G). Only
+ * destroyTransport may be called afterwards.
+ */
+int transportReleaseBuffers(Transport *t);
+
+/**
+ * TRANSPORT_RING: changes the number of rows of each process.
+ * m is the new local M_k block with rowCounts[myrank] rows. Its data
+ * must have room for the largest block: the blocks rotate through the
+ * buffers. The transport takes ownership of m.
+ */
+int transportSetDistribution(Transport *t, const long *rowCounts, Matrix *m);
+
+/**
+ * Largest number of rows of any process
+ */
+long transportMaxRows(const Transport *t);
+
+/**
+ * Multiplies the local rows of A by the full M_k-1 matrix and adds the
+ * result to multiplied
+ */
+int transportMultiply(Transport *t, const Matrix *a, Matrix *multiplied);
+
+/**
+ * Replaces the local M_k block with the values in multiplied.
+ * The contents of multiplied are undefined afterwards.
+ */
+int transportSwap(Transport *t, Matrix *multiplied);
+
+/**
+ * Makes the local M_k block visible to the other processes.
+ * Must be called by every process after the block is updated.
+ */
+int transportPublish(Transport *t);
+
+/**
+ * Ends a term that had no convergence check.
+ * TRANSPORT_RMA relies on the convergence collectives to know that
+ * nobody still reads the block it is about to overwrite, so without
+ * them it needs a barrier.
+ */
+int transportSync(Transport *t);
+
+#endif
@@ -42,6 +42,93 @@
 #define MESSAGE_TAG_M_LINE 1
 #define MESSAGE_TAG_A_LINE 2
 #define MESSAGE_TAG_S_FINAL_LINE 3
+#define MESSAGE_TAG_PLANNER 4
+#define MESSAGE_TAG_BLOCK_COLUMN 5
+
+// First tag of the column tiles of the task graph (-G), two per tile
+#define MESSAGE_TAG_M_TILE 6
+
+// How the M_k blocks are moved between processes
+#define TRANSPORT_RING 0
+#define TRANSPORT_SHM 1
+#define TRANSPORT_RMA 2
+
+// Compression of the ring messages (-z) and the fraction of the
+// tolerance that the error of one term's messages may add to M_k
+#define COMPRESSION_NONE 0
+#define COMPRESSION_FLOAT 1
+#define COMPRESSION_QUANTIZE 2
+#define COMPRESSION_ERROR 0.1
+
+// Adaptive row distribution (-l): terms between throughput checks and
+// the multiply time difference (fraction) that triggers a rebalance
+#define ADAPTIVE_CHECK_TERMS 3
+#define ADAPTIVE_IMBALANCE 0.1
+
+// Planner (-P) calibration: block size for the flop rate, message size
+// (doubles) and repetitions for the ping-pong and power iterations for
+// the number of terms estimate
+#define PLANNER_BLOCK_SIZE 128
+#define PLANNER_MESSAGE_SIZE 131072
+#define PLANNER_REPETITIONS 10
+#define PLANNER_POWER_ITERATIONS 10
+
+// Kernels instrumented with the hardware counters (-p)
+#define PERF_KERNEL_MULTIPLY 0
+#define PERF_KERNEL_SUM 1
+#define PERF_KERNEL_DIVIDE 2
+#define PERF_N_KERNELS 3
+
+// Counters read for each kernel: cycles, instructions,
+// L1 data cache read misses and last level cache misses
+#define PERF_N_COUNTERS 4
+#define CACHE_LINE_SIZE 64
+
+// Roofline calibration (-p): multiply-adds per chain for the peak flop
+// rate, doubles per array for the bandwidth and repetitions (best of)
+#define PERF_PEAK_ITERATIONS 20000000
+#define PERF_BANDWIDTH_SIZE 4194304
+#define PERF_REPETITIONS 3
+
+// Matrix kernel backends (-b)
+#define BACKEND_BUILTIN 0
+#define BACKEND_CBLAS 1
+#define BACKEND_CHECK 2
+
+// Incremental updates (-U): exp(A / 2^l) kept for l = 0..UPDATE_LEVELS
+#define UPDATE_LEVELS 6
+
+// Result cache (-C): hex key length and default size limit (MB)
+#define CACHE_KEY_LENGTH 32
+#define CACHE_DEFAULT_LIMIT 1024
+
+// Ensemble mode (-E): longest output file name
+#define ENSEMBLE_NAME_LENGTH 1024
+
+// Threaded multiply (-j): sub-products smaller than this (l * m * n)
+// run in the current task
+#define TASK_THRESHOLD 262144
+
+// Live metrics (-M): longest path of the metrics file
+#define METRICS_PATH_LENGTH 4096
+
+// Task graph (-G): columns per tile of M_k
+#define TASK_GRAPH_TILE 256
+
+// Long options, without a short form: their values are above any char
+#define OPTION_DRY_RUN 256
+
+// Memory accounting categories (see memory.h): matrices, Strassen
+// temporaries, receive buffers, zeroes for the resets and MPI windows
+#define MEMORY_MATRICES 0
+#define MEMORY_TEMPORARIES 1
+#define MEMORY_BUFFERS 2
+#define MEMORY_ZEROES 3
+#define MEMORY_WINDOWS 4
+#define MEMORY_N_CATEGORIES 5
+
+// Tiled layout (-Z): tile side, 3 tiles fit in a 48KB L1 cache
+#define TILE_SIZE 32
 
 #define PROCESS_STOP 0
 #define PROCESS_CONTINUE 1
@@ -53,6 +140,14 @@
 #define USE_LONG_FORMAT 1
 #define LONG_FORMAT " %11.4e"
 
+// Full matrix output (-F): max chars for one formatted value and
+// size of the buffer each formatting thread fills before writing
+#define MAX_FORMATTED_DOUBLE 320 // %.4f of DBL_MAX
+#define OUTPUT_BUFFER_SIZE 33554432
+
+// Matrices waiting for the background writer (-W)
+#define ASYNC_QUEUE_SIZE 4
+
 #define MAX_ROWS_TO_OUTPUT 20
 #define MAX_COLUMNS_TO_OUTPUT 20
 